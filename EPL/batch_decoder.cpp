@@ -0,0 +1,157 @@
+#include "batch_decoder.h"
+#include "decoder_context.h"
+#include "png_decoder.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static bool has_png_extension(const std::filesystem::path &path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == ".png";
+}
+
+static void read_path_list(std::istream &list, std::vector<std::string> &paths)
+{
+    std::string line;
+    while (std::getline(list, line))
+    {
+        // Tolerate CRLF lists and blank lines
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            paths.push_back(line);
+    }
+}
+
+// Add every *.png file under `root` to `paths`, without following directory symlinks. Entries that cannot be read are
+// reported and skipped, the rest of the tree is still collected.
+static void collect_directory(const std::filesystem::path &root, std::vector<std::string> &paths)
+{
+    // Directories are walked from a stack: recursive_directory_iterator ends the whole walk when a subdirectory fails to open
+    std::vector<std::filesystem::path> directories = {root};
+    while (!directories.empty())
+    {
+        const std::filesystem::path directory = std::move(directories.back());
+        directories.pop_back();
+
+        std::error_code error;
+        std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error && it != std::filesystem::directory_iterator(); it.increment(error))
+        {
+            const std::filesystem::directory_entry &entry = *it;
+            std::error_code entry_error;
+            if (entry.symlink_status(entry_error).type() == std::filesystem::file_type::directory)
+                directories.push_back(entry.path());
+            else if (has_png_extension(entry.path()) && entry.is_regular_file(entry_error))
+                paths.push_back(entry.path().string());
+            if (entry_error)
+                std::cerr << "Error reading " << entry.path().string() << ": " << entry_error.message() << ", skipping it." << std::endl;
+        }
+        if (error)
+            std::cerr << "Error reading directory " << directory.string() << ": " << error.message() << ", skipping the rest of it." << std::endl;
+    }
+}
+
+bool collect_png_paths(const std::string &input, std::vector<std::string> &paths)
+{
+    if (input == "-")
+    {
+        read_path_list(std::cin, paths);
+        return true;
+    }
+
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error))
+    {
+        collect_directory(input, paths);
+        // Directory order is unspecified, keep runs reproducible
+        std::sort(paths.begin(), paths.end());
+        return true;
+    }
+
+    std::ifstream list(input);
+    if (!list.is_open())
+    {
+        std::cerr << "Error opening batch input " << input << "." << std::endl;
+        return false;
+    }
+    read_path_list(list, paths);
+    return true;
+}
+
+batch_result_t decode_png_batch(const std::vector<std::string> &paths, const decode_options_t &options, size_t thread_count)
+{
+    work_stealing_pool_t pool(thread_count);
+
+    // Per-worker decoder state: the properties keep their buffers (pixels, scratch) and the contexts their inflate
+    // stream, row buffers and conversion tables between images
+    std::vector<png_properties_t> worker_properties(pool.size());
+    std::vector<decoder_context_t> worker_contexts(pool.size());
+    std::vector<decode_stats_t> worker_stats(pool.size());
+
+    std::atomic<size_t> images_decoded{0};
+    std::atomic<size_t> images_failed{0};
+    std::atomic<size_t> bytes_in{0};
+    std::atomic<size_t> bytes_out{0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &path : paths)
+    {
+        pool.submit([&, path](size_t worker_index) {
+            png_properties_t &properties = worker_properties[worker_index];
+            const bool decoded = decode_png_file(path.c_str(), properties, worker_contexts[worker_index], options);
+            accumulate_decode_stats(worker_stats[worker_index], properties.stats);
+            if (!decoded)
+            {
+                std::cerr << "Error decoding " << path << "." << std::endl;
+                images_failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::error_code error;
+            uintmax_t file_size = std::filesystem::file_size(path, error);
+            if (!error)
+                bytes_in.fetch_add(file_size, std::memory_order_relaxed);
+            bytes_out.fetch_add(properties.pixels.size(), std::memory_order_relaxed);
+            images_decoded.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    pool.wait();
+
+    batch_result_t result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.images_decoded = images_decoded.load();
+    result.images_failed = images_failed.load();
+    result.bytes_in = bytes_in.load();
+    result.bytes_out = bytes_out.load();
+    result.threads = pool.size();
+    for (const png_properties_t &properties : worker_properties)
+    {
+        result.scratch_allocations += properties.scratch.stats.allocations;
+        result.scratch_heap_allocations += properties.scratch.stats.heap_allocations;
+    }
+    for (const decode_stats_t &stats : worker_stats)
+        accumulate_decode_stats(result.stats, stats);
+    return result;
+}
+
+std::ostream &operator<<(std::ostream &os, const batch_result_t &result)
+{
+    const double seconds = result.seconds > 0.0 ? result.seconds : 1e-9;
+    os << "\tImages decoded: " << result.images_decoded << " (" << result.images_failed << " failed)\n"
+       << "\tThreads: " << result.threads << "\n"
+       << "\tElapsed: " << result.seconds << " s\n"
+       << "\tThroughput: " << result.images_decoded / seconds << " images/s\n"
+       << "\tInput: " << result.bytes_in / seconds / 1e6 << " MB/s\n"
+       << "\tOutput: " << result.bytes_out / seconds / 1e6 << " MB/s\n"
+       << "\tChunk scratch: " << result.scratch_allocations << " allocations, " << result.scratch_heap_allocations << " from the heap\n";
+    if (DECODE_STATS_ENABLED)
+        os << "Decode stats (all images, stage times summed over the workers):\n" << result.stats;
+    return os;
+}
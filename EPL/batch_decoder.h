@@ -0,0 +1,35 @@
+#ifndef __BATCH_DECODER_H__
+#define __BATCH_DECODER_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "decode_options.h"
+#include "decode_stats.h"
+
+// Aggregate results of a batch decode
+typedef struct _batch_result
+{
+    size_t images_decoded = 0;
+    size_t images_failed = 0;
+    size_t bytes_in = 0;  // PNG file bytes
+    size_t bytes_out = 0; // Decoded pixel bytes
+    double seconds = 0.0;
+    size_t threads = 0;
+    size_t scratch_allocations = 0;      // Chunk scratch allocations of all workers
+    size_t scratch_heap_allocations = 0; // Heap allocations the arenas made, flat once every arena has grown to its working size
+    decode_stats_t stats;                // Sum of the stats of every decode (collected with EPL_WITH_STATS only)
+} batch_result_t;
+
+// Collect the PNG paths of a batch: every *.png file under a directory, one path per line of a list file,
+// or one path per line of stdin when `input` is "-". Unreadable entries of a directory are reported and skipped.
+bool collect_png_paths(const std::string &input, std::vector<std::string> &paths);
+
+// Decode every file concurrently on a work-stealing pool (0 threads means one per core).
+// Every worker keeps its own decoder state, reused from one image to the next.
+batch_result_t decode_png_batch(const std::vector<std::string> &paths, const decode_options_t &options = {}, size_t thread_count = 0);
+
+std::ostream &operator<<(std::ostream &os, const batch_result_t &result);
+
+#endif // __BATCH_DECODER_H__
@@ -0,0 +1,51 @@
+#ifndef __BYTE_BUFFER_H__
+#define __BYTE_BUFFER_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifdef EPL_WITH_STATS
+// Byte buffer allocations made by this thread, see decode_stats_t::buffer_allocations
+inline thread_local uint64_t byte_buffer_allocations = 0;
+#endif
+
+// Allocator that default-initializes elements, so resize() on a byte vector does not zero-fill memory
+// that is about to be overwritten by inflate or the unfilter stage anyway
+template <typename T, typename A = std::allocator<T>>
+class default_init_allocator : public A
+{
+  public:
+    template <typename U>
+    struct rebind
+    {
+        using other = default_init_allocator<U, typename std::allocator_traits<A>::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+
+#ifdef EPL_WITH_STATS
+    T *allocate(std::size_t n)
+    {
+        byte_buffer_allocations++;
+        return A::allocate(n);
+    }
+#endif
+
+    template <typename U>
+    void construct(U *ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+    {
+        ::new (static_cast<void *>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *ptr, Args &&...args)
+    {
+        std::allocator_traits<A>::construct(static_cast<A &>(*this), ptr, std::forward<Args>(args)...);
+    }
+};
+
+// Byte buffer for large decode outputs (decompressed scanlines, pixels)
+typedef std::vector<uint8_t, default_init_allocator<uint8_t>> byte_buffer_t;
+
+#endif // __BYTE_BUFFER_H__
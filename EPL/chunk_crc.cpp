@@ -0,0 +1,166 @@
+#include "chunk_crc.h"
+#include "chunk_types.h"
+#include "cpu_features.h"
+#include <iostream>
+#include <string>
+
+// Reflected CRC-32 polynomial
+static const uint32_t CRC32_POLYNOMIAL = 0xEDB88320;
+
+// table[0] is the classic byte-at-a-time table, table[k][b] is the CRC of byte b followed by k zero bytes,
+// so 8 bytes are folded with 8 independent lookups
+typedef struct _crc_tables
+{
+    uint32_t table[8][256];
+
+    constexpr _crc_tables() : table()
+    {
+        for (uint32_t b = 0; b < 256; b++)
+        {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; bit++)
+                crc = crc & 1 ? crc >> 1 ^ CRC32_POLYNOMIAL : crc >> 1;
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+            for (uint32_t b = 0; b < 256; b++)
+                table[k][b] = table[k - 1][b] >> 8 ^ table[0][table[k - 1][b] & 0xFF];
+    }
+} crc_tables_t;
+
+static constexpr crc_tables_t CRC_TABLES;
+
+static inline uint32_t read_le32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Slicing-by-8 over the inverted register (no pre / post inversion)
+static uint32_t crc32_tables(uint32_t crc, const uint8_t *data, size_t size)
+{
+    const auto &t = CRC_TABLES.table;
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        const uint32_t one = read_le32(data) ^ crc;
+        const uint32_t two = read_le32(data + 4);
+        crc = t[7][one & 0xFF] ^ t[6][one >> 8 & 0xFF] ^ t[5][one >> 16 & 0xFF] ^ t[4][one >> 24] ^ t[3][two & 0xFF] ^ t[2][two >> 8 & 0xFF] ^ t[1][two >> 16 & 0xFF] ^
+              t[0][two >> 24];
+    }
+    for (; size > 0; size--, data++)
+        crc = crc >> 8 ^ t[0][(crc ^ *data) & 0xFF];
+    return crc;
+}
+
+#if defined(EPL_HAVE_AVX2)
+// Multiply both halves of `x` by x^k mod P and add the next block
+EPL_TARGET_PCLMUL static inline __m128i fold_16(__m128i x, __m128i next, __m128i constants)
+{
+    const __m128i high = _mm_clmulepi64_si128(x, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, constants, 0x00), high), next);
+}
+
+// Fold 16-byte blocks with carry-less multiplications by x^k mod P (Intel, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction"), then reduce the last 128 bits to 32 with a Barrett reduction.
+// `size` is at least 64 and a multiple of 16. Works on the inverted register like crc32_tables.
+EPL_TARGET_PCLMUL static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t size)
+{
+    // x^(4*128+32) and x^(4*128-32) mod P for the 64-byte folds, x^(128+32) and x^(128-32) for the 16-byte ones
+    const __m128i k1k2 = _mm_set_epi64x(0x1C6E41596, 0x154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x0CCAA009E, 0x1751997D0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x163CD6124);
+    const __m128i poly = _mm_set_epi64x(0x1F7011641, 0x1DB710641); // mu and P for the Barrett reduction
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48));
+    data += 64;
+    size -= 64;
+
+    // Four independent folding chains hide the multiplication latency
+    for (; size >= 64; size -= 64, data += 64)
+    {
+        __m128i h1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        __m128i h2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        __m128i h3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        __m128i h4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, h1), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, h2), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, h3), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, h4), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48)));
+    }
+
+    // Fold the four chains into one, then the remaining 16-byte blocks into it
+    x1 = fold_16(x1, x2, k3k4);
+    x1 = fold_16(x1, x3, k3k4);
+    x1 = fold_16(x1, x4, k3k4);
+    for (; size >= 16; size -= 16, data += 16)
+        x1 = fold_16(x1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), k3k4);
+
+    // 128 -> 64 bits (appending the 32 zero bits of the CRC), then 64 -> 32 bits
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(k3k4, x1, 0x01), _mm_srli_si128(x1, 8));
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00), _mm_srli_si128(x1, 4));
+
+    // Barrett reduction
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x1, t), 1));
+}
+#endif
+
+uint32_t crc32_slicing_by_8(uint32_t crc, const uint8_t *data, size_t size)
+{
+    return ~crc32_tables(~crc, data, size);
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size)
+{
+    crc = ~crc;
+#if defined(EPL_HAVE_AVX2)
+    // Short chunks (most ancillary ones) are not worth the folding setup
+    if (size >= 64 && cpu_has_pclmul())
+    {
+        const size_t folded = size & ~static_cast<size_t>(15);
+        crc = crc32_pclmul(crc, data, folded);
+        data += folded;
+        size -= folded;
+    }
+#endif
+    return ~crc32_tables(crc, data, size);
+}
+
+bool crc_wanted(crc_policy_t policy, uint32_t fourcc)
+{
+    switch (policy)
+    {
+    case CRC_VERIFY_CRITICAL:
+        return is_critical_chunk(fourcc);
+    case CRC_SKIP_IDAT:
+        return fourcc != CHUNK_IDAT;
+    default:
+        return true;
+    }
+}
+
+bool verify_chunk_crc(const png_chunk_t &chunk)
+{
+    // CRC-32 computed over the chunk type and chunk data, but not the length
+    const uint8_t type[4] = {static_cast<uint8_t>(chunk.fourcc >> 24), static_cast<uint8_t>(chunk.fourcc >> 16), static_cast<uint8_t>(chunk.fourcc >> 8),
+                             static_cast<uint8_t>(chunk.fourcc)};
+    uint32_t crc = crc32_update(0, type, 4);
+    crc = crc32_update(crc, chunk.buffer.data(), chunk.length);
+
+    const uint8_t *stored = chunk.buffer.data() + chunk.length;
+    const uint32_t expected = static_cast<uint32_t>(stored[0]) << 24 | static_cast<uint32_t>(stored[1]) << 16 | static_cast<uint32_t>(stored[2]) << 8 | stored[3];
+    if (crc != expected)
+    {
+        std::cerr << "Error: Parse " << std::string(chunk.type, 4) << " chunk - CRC mismatch!" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef __CHUNK_CRC_H__
+#define __CHUNK_CRC_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "decode_options.h"
+#include "png_source.h"
+
+// CRC-32 (ISO 3309, the one PNG and zlib use), continuing from `crc` like zlib's crc32(): start from 0.
+// Folds 64 bytes per step with PCLMULQDQ when the CPU has it, slicing-by-8 tables otherwise.
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size);
+
+// Portable slicing-by-8 implementation, also used for the tails the folding leaves
+uint32_t crc32_slicing_by_8(uint32_t crc, const uint8_t *data, size_t size);
+
+// Whether the policy asks for the CRC of a chunk type to be checked
+bool crc_wanted(crc_policy_t policy, uint32_t fourcc);
+
+// Check the CRC of a chunk whose data has been read (computed over the type and data, stored after the data)
+bool verify_chunk_crc(const png_chunk_t &chunk);
+
+#endif // __CHUNK_CRC_H__
@@ -0,0 +1,40 @@
+#include "chunk_handlers.h"
+#include "chunk_types.h"
+#include <iostream>
+#include <string>
+
+bool register_chunk_handler(chunk_handlers_t &handlers, const char (&type)[5], chunk_handler_t handler)
+{
+    return register_chunk_handler(handlers, chunk_fourcc(type), std::move(handler));
+}
+
+bool register_chunk_handler(chunk_handlers_t &handlers, uint32_t fourcc, chunk_handler_t handler)
+{
+    if (is_builtin_chunk(fourcc))
+    {
+        const char type[4] = {static_cast<char>(fourcc >> 24), static_cast<char>(fourcc >> 16), static_cast<char>(fourcc >> 8), static_cast<char>(fourcc)};
+        std::cerr << "Error: " << std::string(type, 4) << " chunks are parsed by the decoder!" << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < handlers.types.size(); i++)
+    {
+        if (handlers.types[i] == fourcc)
+        {
+            handlers.handlers[i] = std::move(handler);
+            return true;
+        }
+    }
+    handlers.types.push_back(fourcc);
+    handlers.handlers.push_back(std::move(handler));
+    return true;
+}
+
+const chunk_handler_t *find_chunk_handler(const chunk_handlers_t &handlers, uint32_t fourcc)
+{
+    // A handful of handlers at most: a linear scan over the packed types beats hashing
+    for (size_t i = 0; i < handlers.types.size(); i++)
+        if (handlers.types[i] == fourcc)
+            return &handlers.handlers[i];
+    return nullptr;
+}
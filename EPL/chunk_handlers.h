@@ -0,0 +1,30 @@
+#ifndef __CHUNK_HANDLERS_H__
+#define __CHUNK_HANDLERS_H__
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "png_properties.h"
+#include "png_source.h"
+
+// Handler for a chunk type the decoder does not parse itself (private or application-specific chunks).
+// Like the built-in parsers it receives the chunk data followed by its 4-byte CRC; returning false fails the decoding.
+typedef std::function<bool(const png_chunk_t &chunk, png_properties_t &properties)> chunk_handler_t;
+
+// Custom chunk handlers, looked up by FourCC. Chunks without a handler are skipped without being read.
+typedef struct _chunk_handlers
+{
+    std::vector<uint32_t> types;
+    std::vector<chunk_handler_t> handlers;
+} chunk_handlers_t;
+
+// Add (or replace) the handler of a chunk type, e.g. register_chunk_handler(handlers, "prIv", ...).
+// Built-in chunk types cannot be overridden.
+bool register_chunk_handler(chunk_handlers_t &handlers, const char (&type)[5], chunk_handler_t handler);
+bool register_chunk_handler(chunk_handlers_t &handlers, uint32_t fourcc, chunk_handler_t handler);
+
+// Handler registered for a chunk type, or nullptr
+const chunk_handler_t *find_chunk_handler(const chunk_handlers_t &handlers, uint32_t fourcc);
+
+#endif // __CHUNK_HANDLERS_H__
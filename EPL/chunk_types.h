@@ -0,0 +1,81 @@
+#ifndef __CHUNK_TYPES_H__
+#define __CHUNK_TYPES_H__
+
+#include <cstdint>
+
+// Chunk type as a big-endian FourCC, the way the 4 type bytes are stored in the file
+constexpr uint32_t chunk_fourcc(const char (&name)[5])
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(name[0])) << 24 | static_cast<uint32_t>(static_cast<uint8_t>(name[1])) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(name[2])) << 8 | static_cast<uint32_t>(static_cast<uint8_t>(name[3]));
+}
+
+// Chunk types the decoder knows about
+enum chunk_type_t : uint32_t
+{
+    CHUNK_IHDR = chunk_fourcc("IHDR"),
+    CHUNK_PLTE = chunk_fourcc("PLTE"),
+    CHUNK_IDAT = chunk_fourcc("IDAT"),
+    CHUNK_IEND = chunk_fourcc("IEND"),
+    CHUNK_bKGD = chunk_fourcc("bKGD"),
+    CHUNK_cHRM = chunk_fourcc("cHRM"),
+    CHUNK_cICP = chunk_fourcc("cICP"),
+    CHUNK_dSIG = chunk_fourcc("dSIG"),
+    CHUNK_eXIf = chunk_fourcc("eXIf"),
+    CHUNK_gAMA = chunk_fourcc("gAMA"),
+    CHUNK_hIST = chunk_fourcc("hIST"),
+    CHUNK_iCCP = chunk_fourcc("iCCP"),
+    CHUNK_iDOT = chunk_fourcc("iDOT"),
+    CHUNK_iTXt = chunk_fourcc("iTXt"),
+    CHUNK_pHYs = chunk_fourcc("pHYs"),
+    CHUNK_sBIT = chunk_fourcc("sBIT"),
+    CHUNK_sPLT = chunk_fourcc("sPLT"),
+    CHUNK_sRGB = chunk_fourcc("sRGB"),
+    CHUNK_sTER = chunk_fourcc("sTER"),
+    CHUNK_tEXt = chunk_fourcc("tEXt"),
+    CHUNK_tIME = chunk_fourcc("tIME"),
+    CHUNK_tRNS = chunk_fourcc("tRNS"),
+    CHUNK_zTXt = chunk_fourcc("zTXt"),
+};
+
+// Whether the decoder has a parser for the chunk type
+constexpr bool is_builtin_chunk(uint32_t fourcc)
+{
+    switch (fourcc)
+    {
+    case CHUNK_IHDR:
+    case CHUNK_PLTE:
+    case CHUNK_IDAT:
+    case CHUNK_IEND:
+    case CHUNK_bKGD:
+    case CHUNK_cHRM:
+    case CHUNK_cICP:
+    case CHUNK_dSIG:
+    case CHUNK_eXIf:
+    case CHUNK_gAMA:
+    case CHUNK_hIST:
+    case CHUNK_iCCP:
+    case CHUNK_iDOT:
+    case CHUNK_iTXt:
+    case CHUNK_pHYs:
+    case CHUNK_sBIT:
+    case CHUNK_sPLT:
+    case CHUNK_sRGB:
+    case CHUNK_sTER:
+    case CHUNK_tEXt:
+    case CHUNK_tIME:
+    case CHUNK_tRNS:
+    case CHUNK_zTXt:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Critical chunks have an uppercase first letter (bit 5 of the first byte clear): an image with an unknown one cannot be decoded
+constexpr bool is_critical_chunk(uint32_t fourcc)
+{
+    return (fourcc & 0x20000000) == 0;
+}
+
+#endif // __CHUNK_TYPES_H__
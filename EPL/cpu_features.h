@@ -0,0 +1,53 @@
+#ifndef __CPU_FEATURES_H__
+#define __CPU_FEATURES_H__
+
+// x86 SIMD support is detected at compile time (baseline SSE2) and at runtime (AVX2 and newer),
+// so a single binary can run on any x86-64 host and still use the widest kernels available.
+#if defined(__x86_64__) || defined(_M_X64)
+#define EPL_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Per-function target attributes let AVX2 kernels live next to the SSE2 ones without compiling the whole project with -mavx2
+#if defined(EPL_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define EPL_HAVE_AVX2 1
+#define EPL_TARGET_AVX2 __attribute__((target("avx2")))
+#define EPL_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define EPL_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#include <immintrin.h>
+#endif
+
+// Check whether the running CPU supports AVX2 (the result is cached after the first call)
+inline bool cpu_has_avx2()
+{
+#if defined(EPL_HAVE_AVX2)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+// Check whether the running CPU supports SSSE3 (pshufb byte shuffles)
+inline bool cpu_has_ssse3()
+{
+#if defined(EPL_HAVE_AVX2)
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+#else
+    return false;
+#endif
+}
+
+// Check whether the running CPU supports carry-less multiplication (PCLMULQDQ) along with SSE4.1
+inline bool cpu_has_pclmul()
+{
+#if defined(EPL_HAVE_AVX2)
+    static const bool has_pclmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return has_pclmul;
+#else
+    return false;
+#endif
+}
+
+#endif // __CPU_FEATURES_H__
@@ -0,0 +1,52 @@
+#include "crc_checker.h"
+#include "chunk_crc.h"
+
+crc_checker_t::~crc_checker_t()
+{
+    finish();
+}
+
+void crc_checker_t::submit(const png_chunk_t &chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(chunk);
+    }
+    if (!thread.joinable())
+        thread = std::thread(&crc_checker_t::worker_loop, this);
+    work_available.notify_one();
+}
+
+bool crc_checker_t::finish()
+{
+    if (thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_one();
+        thread.join();
+    }
+    return !failed();
+}
+
+void crc_checker_t::worker_loop()
+{
+    while (true)
+    {
+        png_chunk_t chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this] { return stopping || next_chunk < queue.size(); });
+            // Drain the queue before stopping, every submitted chunk gets checked
+            if (next_chunk == queue.size())
+                return;
+            chunk = queue[next_chunk++];
+        }
+
+        // Once a CRC has failed the image is rejected anyway, the remaining chunks are not worth checking
+        if (!failed() && !verify_chunk_crc(chunk))
+            mismatch.store(true, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef __CRC_CHECKER_H__
+#define __CRC_CHECKER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "png_source.h"
+
+// Verifies chunk CRCs on a helper thread, so the CRC of the IDAT data is computed while the decoding thread inflates it.
+// The submitted chunk views must stay valid until finish() returns (see png_source_t::stable_chunk_data).
+class crc_checker_t
+{
+  public:
+    crc_checker_t() = default;
+    crc_checker_t(const crc_checker_t &) = delete;
+    crc_checker_t &operator=(const crc_checker_t &) = delete;
+    ~crc_checker_t();
+
+    // Queue the CRC check of a chunk whose data has been read; the thread is started on the first chunk
+    void submit(const png_chunk_t &chunk);
+
+    // Whether a mismatch has been found so far, to stop decoding early
+    bool failed() const
+    {
+        return mismatch.load(std::memory_order_relaxed);
+    }
+
+    // Wait until every queued chunk has been checked and stop the thread. Returns false if any CRC did not match.
+    bool finish();
+
+  private:
+    void worker_loop();
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::vector<png_chunk_t> queue; // Unlike a deque, an unused checker allocates nothing
+    size_t next_chunk = 0;          // Next chunk of the queue to check
+    bool stopping = false;
+    std::atomic<bool> mismatch{false};
+};
+
+#endif // __CRC_CHECKER_H__
@@ -0,0 +1,25 @@
+#include "decode_log.h"
+#include <mutex>
+
+std::atomic<uint8_t> log_threshold{LOG_SILENT};
+
+static std::mutex log_mutex;
+static std::ostream *log_stream = &std::clog;
+
+void set_log_level(log_level_t level)
+{
+    log_threshold.store(level, std::memory_order_relaxed);
+}
+
+void set_log_stream(std::ostream &stream)
+{
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_stream = &stream;
+}
+
+void write_log(const std::string &message)
+{
+    // No flush per message: the caller's stream decides when to write out
+    std::lock_guard<std::mutex> lock(log_mutex);
+    *log_stream << message << '\n';
+}
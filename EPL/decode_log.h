@@ -0,0 +1,46 @@
+#ifndef __DECODE_LOG_H__
+#define __DECODE_LOG_H__
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// How much the decoder reports about what it parses. Errors are not logged here: they always go to std::cerr.
+enum log_level_t : uint8_t
+{
+    LOG_SILENT, // Nothing (the default)
+    LOG_INFO,   // Image properties: header, palette, physical size, background color
+    LOG_DEBUG,  // Every chunk parsed, IDAT chunks included
+};
+
+// Threshold shared by all threads, read with a relaxed load so a disabled message costs one compare
+extern std::atomic<uint8_t> log_threshold;
+
+inline bool log_enabled(log_level_t level)
+{
+    return level != LOG_SILENT && level <= log_threshold.load(std::memory_order_relaxed);
+}
+
+void set_log_level(log_level_t level);
+
+// Where messages go (std::clog by default), the stream must outlive the decoding
+void set_log_stream(std::ostream &stream);
+
+// Write one message as a single line, messages of concurrent decodes are not interleaved
+void write_log(const std::string &message);
+
+// Log a message built with <<, only formatted when its level is enabled
+#define EPL_LOG(level, message)                                                                                                                                                    \
+    do                                                                                                                                                                             \
+    {                                                                                                                                                                              \
+        if (log_enabled(level))                                                                                                                                                    \
+        {                                                                                                                                                                          \
+            std::ostringstream log_message;                                                                                                                                        \
+            log_message << message;                                                                                                                                                \
+            write_log(log_message.str());                                                                                                                                          \
+        }                                                                                                                                                                          \
+    } while (0)
+
+#endif // __DECODE_LOG_H__
@@ -0,0 +1,100 @@
+#ifndef __DECODE_OPTIONS_H__
+#define __DECODE_OPTIONS_H__
+
+#include <cstdint>
+
+#include "inflate_backend.h"
+
+// How 16-bit samples are returned
+enum sample16_mode_t : uint8_t
+{
+    SAMPLE16_BIG_ENDIAN, // As stored in the PNG stream
+    SAMPLE16_NATIVE,     // Native-endian uint16_t
+    SAMPLE16_TO_8BIT,    // Reduced to 8 bits, rounded to the nearest value (v * 255 / 65535)
+};
+
+// Which chunk CRCs are checked
+enum crc_policy_t : uint8_t
+{
+    CRC_VERIFY_ALL,      // Every chunk that is read
+    CRC_VERIFY_CRITICAL, // IHDR, PLTE, IDAT and IEND only
+    CRC_SKIP_IDAT,       // Every chunk but IDAT, for trusted storage that already checksums the image data
+};
+
+// Rectangle of the image to decode, a zero width or height extends it to the right / bottom edge of the image
+typedef struct _region
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+} region_t;
+
+typedef struct _chunk_handlers chunk_handlers_t;
+
+// Options controlling how a PNG file is decoded
+typedef struct _decode_options
+{
+    // Inflate every IDAT chunk as soon as it is read, instead of concatenating all of them and inflating at IEND
+    // (whole-buffer backends such as libdeflate always inflate at IEND)
+    bool streaming_inflate = true;
+
+    // With streaming inflate, unfilter and convert every row as soon as it is inflated, through a ring of a few scanlines,
+    // so the decompressed image is never stored and each row is still in cache when it is unfiltered
+    bool fused_unfilter = true;
+
+    // Inflate implementation, INFLATE_AUTO uses the default one (see inflate_backend.h)
+    inflate_backend_id_t inflate_backend = INFLATE_AUTO;
+
+    // Expand indexed pixels to RGB, or RGBA when the image has a tRNS chunk, instead of returning the palette indices
+    bool expand_palette = true;
+
+    // Layout of the samples of 16-bit images (converted row by row, right after unfiltering)
+    sample16_mode_t samples_16bit = SAMPLE16_NATIVE;
+
+    // Unpack 1, 2 and 4-bit samples to one byte per sample (grayscale and indexed images that are not expanded)
+    bool unpack_sub_byte = true;
+
+    // Scale unpacked grayscale levels to the full 0-255 range (e.g. a 1-bit mask becomes 0/255 instead of 0/1)
+    bool scale_gray = false;
+
+    // Return color pixels in BGR/BGRA order (OpenCV's), palette tables are swapped once and truecolor rows as they are decoded
+    bool bgr_order = false;
+
+    // Expand gray + alpha pixels to RGBA (BGRA), the gray level in every color channel, as OpenCV returns them
+    bool expand_gray_alpha = false;
+
+    // Decode only part of the image (the output is region-sized). Rows above the region are still unfiltered since
+    // later rows are predicted from them, but inflating stops after its last row and other columns are never written.
+    region_t region;
+
+    // Decode a thumbnail 1/2, 1/4 or 1/8 the size of the image (or region) in each direction, 1 keeps the full size.
+    // Rows are reduced as soon as they are unfiltered, so the full-size image is never stored. Sub-byte samples are unpacked.
+    uint32_t scale_denominator = 1;
+
+    // Average every block of pixels when scaling, instead of keeping its top-left pixel (point sampling, which skips
+    // converting the other rows). Palette indices that are not expanded are always point sampled.
+    bool box_filter = true;
+
+    // CRC checks: IDAT data is the bulk of a file, so skipping it removes nearly all of the checksumming
+    crc_policy_t crc_policy = CRC_VERIFY_ALL;
+
+    // Check IDAT CRCs on a helper thread while this thread inflates, for single large images. A mismatch still fails
+    // the decoding. Only memory and mapped-file sources qualify, stream sources reuse their chunk buffer and check inline.
+    bool parallel_crc = false;
+
+    // Threads inflating and unfiltering a large non-interlaced image when its zlib stream can be split: at IDAT chunks
+    // that start after a full flush, such as the bands of an iDOT chunk. 1 keeps the serial path, 0 uses one per hardware
+    // thread. Streaming and fused unfiltering are turned off for those images (the IDAT data is gathered), streams that do
+    // not split are then inflated serially.
+    uint32_t inflate_threads = 1;
+
+    // Largest decompressed image data and largest output an image may allocate, in bytes. IHDR allows sizes far beyond
+    // any memory (2^31 x 2^31 pixels), such headers fail the decoding before anything is allocated.
+    uint64_t max_image_bytes = 4ull << 30;
+
+    // Handlers for private / application-specific chunks (see chunk_handlers.h), other unknown ancillary chunks are skipped unread
+    const chunk_handlers_t *chunk_handlers = nullptr;
+} decode_options_t;
+
+#endif // __DECODE_OPTIONS_H__
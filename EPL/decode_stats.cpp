@@ -0,0 +1,41 @@
+#include "decode_stats.h"
+
+const char *decode_stage_name(decode_stage_t stage)
+{
+    static const char *const NAMES[DECODE_STAGE_COUNT] = {"read", "crc", "metadata", "inflate", "unfilter", "convert"};
+    return stage < DECODE_STAGE_COUNT ? NAMES[stage] : "unknown";
+}
+
+void accumulate_decode_stats(decode_stats_t &total, const decode_stats_t &stats)
+{
+    for (int stage = 0; stage < DECODE_STAGE_COUNT; stage++)
+        total.stage_ns[stage] += stats.stage_ns[stage];
+    total.total_ns += stats.total_ns;
+    total.bytes_in += stats.bytes_in;
+    total.compressed_bytes += stats.compressed_bytes;
+    total.inflated_bytes += stats.inflated_bytes;
+    total.bytes_out += stats.bytes_out;
+    total.chunks += stats.chunks;
+    total.idat_chunks += stats.idat_chunks;
+    total.skipped_chunks += stats.skipped_chunks;
+    total.crc_failures += stats.crc_failures;
+    total.buffer_allocations += stats.buffer_allocations;
+    total.scratch_allocations += stats.scratch_allocations;
+    total.scratch_heap_allocations += stats.scratch_heap_allocations;
+}
+
+std::ostream &operator<<(std::ostream &os, const decode_stats_t &stats)
+{
+    if (!DECODE_STATS_ENABLED)
+        return os << "\tStats: not collected (build with EPL_WITH_STATS)\n";
+
+    os << "\tTotal: " << stats.total_ns / 1e6 << " ms\n";
+    for (int stage = 0; stage < DECODE_STAGE_COUNT; stage++)
+        os << "\t" << decode_stage_name(static_cast<decode_stage_t>(stage)) << ": " << stats.stage_ns[stage] / 1e6 << " ms\n";
+    os << "\tBytes: " << stats.bytes_in << " read, " << stats.compressed_bytes << " compressed, " << stats.inflated_bytes << " inflated, " << stats.bytes_out << " output\n"
+       << "\tChunks: " << stats.chunks << " read (" << stats.idat_chunks << " IDAT), " << stats.skipped_chunks << " skipped\n"
+       << "\tCRC failures: " << stats.crc_failures << "\n"
+       << "\tAllocations: " << stats.buffer_allocations << " image buffers, " << stats.scratch_allocations << " chunk scratch (" << stats.scratch_heap_allocations
+       << " from the heap)\n";
+    return os;
+}
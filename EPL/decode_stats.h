@@ -0,0 +1,85 @@
+#ifndef __DECODE_STATS_H__
+#define __DECODE_STATS_H__
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Stages the decoding time is split into
+enum decode_stage_t : uint8_t
+{
+    DECODE_STAGE_READ,     // Chunk headers and data from the source (and IDAT data gathered for a whole-buffer inflate)
+    DECODE_STAGE_CRC,      // Chunk CRCs checked on the decoding thread
+    DECODE_STAGE_METADATA, // IHDR, PLTE, ancillary and custom chunk parsers
+    DECODE_STAGE_INFLATE,
+    DECODE_STAGE_UNFILTER, // Scanline filters
+    DECODE_STAGE_CONVERT,  // Unfiltered rows converted, scattered and scaled into the output
+    DECODE_STAGE_COUNT,
+};
+
+// Timers and counters of the last decode, see png_properties_t::stats. They are only collected when the decoder is
+// built with EPL_WITH_STATS, otherwise the instrumentation compiles to nothing and every field stays zero.
+typedef struct _decode_stats
+{
+    uint64_t stage_ns[DECODE_STAGE_COUNT] = {};
+    uint64_t total_ns = 0;            // The whole decode, time outside the stages included
+    uint64_t bytes_in = 0;            // Chunks read, headers and CRCs included
+    uint64_t compressed_bytes = 0;    // IDAT data
+    uint64_t inflated_bytes = 0;      // Decompressed scanlines the output needed, filter type bytes included
+    uint64_t bytes_out = 0;           // Output pixels
+    uint32_t chunks = 0;              // Chunks read
+    uint32_t idat_chunks = 0;
+    uint32_t skipped_chunks = 0;      // Unknown ancillary chunks, and IDAT chunks past the last row of a region
+    uint32_t crc_failures = 0;
+    uint32_t buffer_allocations = 0;  // Image buffers (byte_buffer_t) allocated or grown, 0 with a warm decoder context
+    uint32_t scratch_allocations = 0; // Chunk scratch allocations, and how many of them the arena took from the heap
+    uint32_t scratch_heap_allocations = 0;
+} decode_stats_t;
+
+#ifdef EPL_WITH_STATS
+static constexpr bool DECODE_STATS_ENABLED = true;
+
+// Adds the time until the end of its scope to a counter (nothing without one)
+class stage_timer_t
+{
+  public:
+    explicit stage_timer_t(uint64_t *counter) : counter(counter)
+    {
+        if (counter != nullptr)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~stage_timer_t()
+    {
+        if (counter != nullptr)
+            *counter += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    stage_timer_t(const stage_timer_t &) = delete;
+    stage_timer_t &operator=(const stage_timer_t &) = delete;
+
+  private:
+    uint64_t *counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Statements that only exist in instrumented builds
+#define EPL_STATS(statement) statement
+
+// Time the rest of the scope as a stage of a decode_stats_t pointer (which may be nullptr)
+#define EPL_TIME_STAGE(stats, stage) stage_timer_t stage_timer((stats) != nullptr ? &(stats)->stage_ns[stage] : nullptr)
+#else
+static constexpr bool DECODE_STATS_ENABLED = false;
+
+#define EPL_STATS(statement)
+#define EPL_TIME_STAGE(stats, stage)
+#endif
+
+const char *decode_stage_name(decode_stage_t stage);
+
+// Add the counters and timers of one decode to a running total
+void accumulate_decode_stats(decode_stats_t &total, const decode_stats_t &stats);
+
+std::ostream &operator<<(std::ostream &os, const decode_stats_t &stats);
+
+#endif // __DECODE_STATS_H__
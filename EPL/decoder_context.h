@@ -0,0 +1,26 @@
+#ifndef __DECODER_CONTEXT_H__
+#define __DECODER_CONTEXT_H__
+
+#include "fused_inflater.h"
+#include "image_scaler.h"
+#include "parallel_inflate.h"
+#include "parsing_chunks.h"
+#include "pixel_conversion.h"
+#include "scanline_decoder.h"
+
+// Decoder state kept from one image to the next. Services decoding many small images pass the same context (and the
+// same png_properties_t) to every call: the inflate stream is reset instead of being set up again, which keeps its
+// 32 KB window, and the row buffers, scanline ring and conversion tables are reused, growing only for a larger image.
+// A context serves one decoding at a time, keep one per thread.
+typedef struct _decoder_context
+{
+    idat_inflater_t inflater;              // Streaming inflate of the whole image (and whole-buffer inflate with a streaming backend)
+    fused_inflater_t fused_inflater;       // Streaming inflate through a scanline ring
+    parallel_inflater_t parallel_inflater; // Inflate of large images split at restart points, keeps its segment buffers
+    row_converter_t converter;             // Keeps its palette and unpack tables while the images share them
+    image_scaler_t scaler;
+    scanline_decoder_t decoder; // Points to the converter and scaler
+    size_t images = 0;          // Decodings started with this context
+} decoder_context_t;
+
+#endif // __DECODER_CONTEXT_H__
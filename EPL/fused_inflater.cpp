@@ -0,0 +1,140 @@
+#include "fused_inflater.h"
+#include "unfiltering.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+_fused_inflater::~_fused_inflater()
+{
+    release_inflate_stream(backend, stream);
+}
+
+bool begin_fused_inflate(fused_inflater_t &inflater, scanline_decoder_t &decoder, bool truncated, const inflate_backend_t *backend, size_t max_ring_size)
+{
+    if (backend == nullptr)
+        backend = find_inflate_backend(INFLATE_AUTO);
+    assert(backend->stream_begin != nullptr);
+
+    // An inflater reused across images resets its stream instead of setting up a new one
+    if (!prepare_inflate_stream(backend, inflater.backend, inflater.stream))
+    {
+        std::cerr << "Error initializing " << backend->name << "." << std::endl;
+        return false;
+    }
+    inflater.decoder = &decoder;
+    inflater.truncated = truncated;
+    inflater.initialized = true;
+    inflater.stream_ended = false;
+    inflater.finished = next_scanline_size(decoder) == 0;
+
+    // The widest scanline is a full-width one (later Adam7 passes never exceed it)
+    const size_t row_size = scanline_stride(decoder.ihdr, decoder.ihdr.width) + 1;
+    if (row_size > max_ring_size / FUSED_RING_ROWS)
+    {
+        std::cerr << "Error: Scanlines of " << decoder.ihdr.width << " pixels are too wide for the inflate ring!" << std::endl;
+        return false;
+    }
+    try
+    {
+        inflater.ring.resize(FUSED_RING_ROWS * row_size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Error: Out of memory allocating the inflate ring!" << std::endl;
+        return false;
+    }
+    inflater.ring_begin = 0;
+    inflater.ring_end = 0;
+    return true;
+}
+
+// Push every complete scanline of the ring, then move the partial one to the front
+static bool push_ready_scanlines(fused_inflater_t &inflater)
+{
+    scanline_decoder_t &decoder = *inflater.decoder;
+    size_t row_size;
+    while ((row_size = next_scanline_size(decoder)) != 0 && inflater.ring_end - inflater.ring_begin >= row_size)
+    {
+        if (!push_scanline(decoder, inflater.ring.data() + inflater.ring_begin))
+            return false;
+        inflater.ring_begin += row_size;
+    }
+
+    const size_t pending = inflater.ring_end - inflater.ring_begin;
+    if (pending != 0 && inflater.ring_begin != 0)
+        std::memmove(inflater.ring.data(), inflater.ring.data() + inflater.ring_begin, pending);
+    inflater.ring_begin = 0;
+    inflater.ring_end = pending;
+    return true;
+}
+
+bool feed_fused_inflate(fused_inflater_t &inflater, const uint8_t *data, size_t size)
+{
+    assert(inflater.initialized);
+
+    // Data after the end of the zlib stream (or of the scanlines a region needs) is ignored
+    if (inflater.finished || inflater.stream_ended)
+        return true;
+
+    inflate_io_t io = {data, size, nullptr, 0};
+    while (true)
+    {
+        io.next_out = inflater.ring.data() + inflater.ring_end;
+        io.avail_out = inflater.ring.size() - inflater.ring_end;
+        const size_t avail_in = io.avail_in;
+        const size_t avail_out = io.avail_out;
+        inflate_status_t status;
+        {
+            EPL_TIME_STAGE(inflater.decoder->stats, DECODE_STAGE_INFLATE);
+            status = inflater.backend->stream_inflate(inflater.stream, io);
+        }
+        inflater.ring_end = inflater.ring.size() - io.avail_out;
+        if (status == INFLATE_ERROR)
+        {
+            std::cerr << "Error during decompression." << std::endl;
+            return false;
+        }
+
+        if (!push_ready_scanlines(inflater))
+            return false;
+
+        // Past the last scanline the decoder needs, the rest of a truncated stream is not inflated and anything else
+        // inflated does not belong to the image
+        if (next_scanline_size(*inflater.decoder) == 0)
+        {
+            if (inflater.truncated)
+            {
+                inflater.ring_end = 0;
+                inflater.finished = true;
+                return true;
+            }
+            if (inflater.ring_end != 0)
+            {
+                std::cerr << "Error during decompression - IDAT stream is larger than the image." << std::endl;
+                return false;
+            }
+        }
+        if (status == INFLATE_STREAM_END)
+        {
+            inflater.stream_ended = true;
+            inflater.finished = next_scanline_size(*inflater.decoder) == 0;
+            return true;
+        }
+        if (io.avail_in == 0 || (io.avail_in == avail_in && io.avail_out == avail_out))
+            return true;
+    }
+}
+
+bool finish_fused_inflate(fused_inflater_t &inflater)
+{
+    if (!inflater.initialized || !inflater.finished || inflater.ring_end != 0)
+    {
+        std::cerr << "Error during decompression - IDAT stream does not match the image size." << std::endl;
+        return false;
+    }
+
+    // The backend stream is kept for the next image, the destructor releases it
+    inflater.initialized = false;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef __FUSED_INFLATER_H__
+#define __FUSED_INFLATER_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "inflate_backend.h"
+#include "scanline_decoder.h"
+
+// Inflates IDAT data into a ring of a few scanlines and pushes every scanline to the scanline decoder as soon as it is
+// complete, so each row is unfiltered (and converted) while it is still in cache and the decompressed image is never
+// stored: the working set is a few rows wide instead of the whole image.
+typedef struct _fused_inflater
+{
+    const inflate_backend_t *backend = nullptr; // A streaming backend
+    void *stream = nullptr;                     // Its stream state
+    scanline_decoder_t *decoder = nullptr;      // Receives the scanlines, owned by the caller
+    bool truncated = false;                     // Scanlines past the ones the decoder needs may follow
+    bool initialized = false;
+    bool stream_ended = false;
+    bool finished = false; // Set once every scanline the decoder needs has been pushed (and the stream has ended unless truncated)
+
+    // Decompressed bytes not pushed yet are [ring_begin, ring_end), a partial scanline is moved back to the front
+    byte_buffer_t ring;
+    size_t ring_begin = 0;
+    size_t ring_end = 0;
+
+    ~_fused_inflater();
+} fused_inflater_t;
+
+// Number of scanlines the ring holds
+static const size_t FUSED_RING_ROWS = 4;
+
+// Initialize the inflater before the first IDAT chunk, for a decoder prepared with begin_scanlines.
+// With `truncated`, the stream may hold more scanlines than the decoder needs and inflating stops after the last one.
+// An inflater reused for another image resets its backend stream instead of setting up a new one.
+// The ring of FUSED_RING_ROWS full-width scanlines may take at most `max_ring_size` bytes.
+bool begin_fused_inflate(fused_inflater_t &inflater, scanline_decoder_t &decoder, bool truncated, const inflate_backend_t *backend = nullptr,
+                         size_t max_ring_size = SIZE_MAX);
+
+// Inflate the next piece of the zlib stream and unfilter every scanline it completes
+bool feed_fused_inflate(fused_inflater_t &inflater, const uint8_t *data, size_t size);
+
+// Check that the zlib stream held exactly the scanlines of the image
+bool finish_fused_inflate(fused_inflater_t &inflater);
+
+#endif // __FUSED_INFLATER_H__
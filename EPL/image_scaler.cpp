@@ -0,0 +1,197 @@
+#include "image_scaler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// How the samples of the converted rows are stored
+enum sample_kind_t
+{
+    SAMPLES_8BIT,
+    SAMPLES_16BIT_NATIVE,
+    SAMPLES_16BIT_BIG_ENDIAN
+};
+
+template <sample_kind_t KIND>
+static inline uint32_t load_sample(const uint8_t *samples, size_t index)
+{
+    if (KIND == SAMPLES_8BIT)
+        return samples[index];
+    if (KIND == SAMPLES_16BIT_BIG_ENDIAN)
+        return static_cast<uint32_t>(samples[index * 2]) << 8 | samples[index * 2 + 1];
+    uint16_t value;
+    std::memcpy(&value, samples + index * 2, 2);
+    return value;
+}
+
+template <sample_kind_t KIND>
+static inline void store_sample(uint8_t *samples, size_t index, uint32_t value)
+{
+    if (KIND == SAMPLES_8BIT)
+    {
+        samples[index] = static_cast<uint8_t>(value);
+        return;
+    }
+    if (KIND == SAMPLES_16BIT_BIG_ENDIAN)
+    {
+        samples[index * 2] = static_cast<uint8_t>(value >> 8);
+        samples[index * 2 + 1] = static_cast<uint8_t>(value);
+        return;
+    }
+    const uint16_t sample = static_cast<uint16_t>(value);
+    std::memcpy(samples + index * 2, &sample, 2);
+}
+
+static sample_kind_t sample_kind(const image_scaler_t &scaler)
+{
+    if (scaler.bit_depth == 8)
+        return SAMPLES_8BIT;
+    return scaler.big_endian ? SAMPLES_16BIT_BIG_ENDIAN : SAMPLES_16BIT_NATIVE;
+}
+
+// Add every pixel to the sums of the output pixel covering its column
+template <sample_kind_t KIND>
+static void accumulate_pixels(uint32_t *sums, const uint8_t *pixels, uint32_t count, uint32_t x0, uint32_t dx, uint32_t shift, uint32_t channels)
+{
+    for (uint32_t i = 0, x = x0; i < count; i++, x += dx)
+    {
+        uint32_t *sum = sums + static_cast<size_t>(x >> shift) * channels;
+        for (uint32_t c = 0; c < channels; c++)
+            sum[c] += load_sample<KIND>(pixels, static_cast<size_t>(i) * channels + c);
+    }
+}
+
+// Copy the pixels in the first column of every block
+template <sample_kind_t KIND>
+static void sample_pixels(uint8_t *dst, const uint8_t *pixels, uint32_t count, uint32_t x0, uint32_t dx, uint32_t shift, uint32_t channels)
+{
+    const uint32_t mask = (1u << shift) - 1;
+    for (uint32_t i = 0, x = x0; i < count; i++, x += dx)
+    {
+        if ((x & mask) != 0)
+            continue;
+        const size_t out = static_cast<size_t>(x >> shift) * channels;
+        for (uint32_t c = 0; c < channels; c++)
+            store_sample<KIND>(dst, out + c, load_sample<KIND>(pixels, static_cast<size_t>(i) * channels + c));
+    }
+}
+
+// Write the averages of output row `out_y` (partial blocks are divided by the number of pixels they have)
+template <sample_kind_t KIND>
+static void write_averages(const image_scaler_t &scaler, const uint32_t *sums, uint32_t out_y)
+{
+    const uint32_t factor = 1u << scaler.shift;
+    const uint32_t block_height = std::min(factor, scaler.height - (out_y << scaler.shift));
+    uint8_t *dst = scaler.output.data + out_y * scaler.output.row_stride;
+    for (uint32_t ox = 0; ox < scaler.output.width; ox++)
+    {
+        const uint32_t count = std::min(factor, scaler.width - (ox << scaler.shift)) * block_height;
+        const size_t out = static_cast<size_t>(ox) * scaler.channels;
+        for (uint32_t c = 0; c < scaler.channels; c++)
+            store_sample<KIND>(dst, out + c, (sums[out + c] + count / 2) / count);
+    }
+}
+
+static void flush_row(image_scaler_t &scaler, const uint32_t *sums, uint32_t out_y)
+{
+    switch (sample_kind(scaler))
+    {
+    case SAMPLES_8BIT:
+        return write_averages<SAMPLES_8BIT>(scaler, sums, out_y);
+    case SAMPLES_16BIT_NATIVE:
+        return write_averages<SAMPLES_16BIT_NATIVE>(scaler, sums, out_y);
+    case SAMPLES_16BIT_BIG_ENDIAN:
+        return write_averages<SAMPLES_16BIT_BIG_ENDIAN>(scaler, sums, out_y);
+    }
+}
+
+uint32_t scaled_size(uint32_t size, uint32_t factor)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(size) + factor - 1) / factor);
+}
+
+bool begin_scaling(image_scaler_t &scaler, const pixel_layout_t &layout, bool big_endian, uint32_t width, uint32_t height, uint32_t factor, bool box_filter, bool interlaced,
+                   const image_view_t &output)
+{
+    if (factor != 2 && factor != 4 && factor != 8)
+    {
+        std::cerr << "Error: Unsupported scale factor 1/" << factor << "!" << std::endl;
+        return false;
+    }
+    if (layout.bit_depth != 8 && layout.bit_depth != 16)
+    {
+        std::cerr << "Error: Scaled decoding needs 8 or 16-bit samples!" << std::endl;
+        return false;
+    }
+
+    scaler.shift = factor == 2 ? 1 : factor == 4 ? 2 : 3;
+    scaler.box_filter = box_filter;
+    scaler.interlaced = interlaced;
+    scaler.channels = layout.channels;
+    scaler.bit_depth = layout.bit_depth;
+    scaler.big_endian = big_endian && layout.bit_depth == 16;
+    scaler.width = width;
+    scaler.height = height;
+    scaler.output = output;
+    scaler.sum_row = 0;
+
+    // Every pass of an interlaced image touches every output row, so all their sums are kept
+    scaler.sums.clear();
+    if (box_filter)
+        scaler.sums.resize(static_cast<size_t>(output.width) * layout.channels * (interlaced ? output.height : 1));
+    return true;
+}
+
+bool scaler_needs_row(const image_scaler_t &scaler, uint32_t y)
+{
+    return scaler.box_filter || (y & ((1u << scaler.shift) - 1)) == 0;
+}
+
+void scale_pixels(image_scaler_t &scaler, const uint8_t *pixels, uint32_t count, uint32_t x0, uint32_t dx, uint32_t y)
+{
+    const uint32_t out_y = y >> scaler.shift;
+    const sample_kind_t kind = sample_kind(scaler);
+    if (!scaler.box_filter)
+    {
+        if (!scaler_needs_row(scaler, y))
+            return;
+        uint8_t *dst = scaler.output.data + out_y * scaler.output.row_stride;
+        if (kind == SAMPLES_8BIT)
+            sample_pixels<SAMPLES_8BIT>(dst, pixels, count, x0, dx, scaler.shift, scaler.channels);
+        else // Point sampling copies samples, the byte order does not matter
+            sample_pixels<SAMPLES_16BIT_NATIVE>(dst, pixels, count, x0, dx, scaler.shift, scaler.channels);
+        return;
+    }
+
+    // Rows of a non-interlaced image arrive in order: a new output row starts once the previous one is complete
+    uint32_t *sums = scaler.sums.data();
+    if (scaler.interlaced)
+        sums += static_cast<size_t>(out_y) * scaler.output.width * scaler.channels;
+    else if (out_y != scaler.sum_row)
+    {
+        flush_row(scaler, sums, scaler.sum_row);
+        std::fill(scaler.sums.begin(), scaler.sums.end(), 0);
+        scaler.sum_row = out_y;
+    }
+
+    switch (kind)
+    {
+    case SAMPLES_8BIT:
+        return accumulate_pixels<SAMPLES_8BIT>(sums, pixels, count, x0, dx, scaler.shift, scaler.channels);
+    case SAMPLES_16BIT_NATIVE:
+        return accumulate_pixels<SAMPLES_16BIT_NATIVE>(sums, pixels, count, x0, dx, scaler.shift, scaler.channels);
+    case SAMPLES_16BIT_BIG_ENDIAN:
+        return accumulate_pixels<SAMPLES_16BIT_BIG_ENDIAN>(sums, pixels, count, x0, dx, scaler.shift, scaler.channels);
+    }
+}
+
+void finish_scaling(image_scaler_t &scaler)
+{
+    if (!scaler.box_filter)
+        return;
+
+    const size_t row_sums = static_cast<size_t>(scaler.output.width) * scaler.channels;
+    if (!scaler.interlaced)
+        return flush_row(scaler, scaler.sums.data(), scaler.sum_row);
+    for (uint32_t out_y = 0; out_y < scaler.output.height; out_y++)
+        flush_row(scaler, scaler.sums.data() + out_y * row_sums, out_y);
+}
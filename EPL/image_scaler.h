@@ -0,0 +1,49 @@
+#ifndef __IMAGE_SCALER_H__
+#define __IMAGE_SCALER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "png_properties.h"
+#include "scanline_decoder.h"
+
+// Reduces an image to 1/2, 1/4 or 1/8 of its size while its rows are decoded, so the full-size image is never stored.
+// Box filtering averages every block of factor x factor pixels (partial blocks at the right and bottom edges average
+// the pixels they have), point sampling keeps the top-left pixel of every block.
+// Rows of a non-interlaced image arrive in order, so a single accumulator row is enough; the pixels of an interlaced
+// image arrive pass by pass, so it keeps one accumulator per output sample until the last pass.
+typedef struct _image_scaler
+{
+    uint32_t shift;       // log2 of the scale factor
+    bool box_filter;      // Average the blocks instead of point sampling them
+    bool interlaced;
+    uint32_t channels;
+    uint8_t bit_depth;    // 8 or 16
+    bool big_endian;      // 16-bit samples are stored big-endian (SAMPLE16_BIG_ENDIAN)
+    uint32_t width;       // Size of the full-resolution image (or region)
+    uint32_t height;
+    image_view_t output;  // Scaled image
+
+    std::vector<uint32_t> sums; // Box filter sums, one output row (non-interlaced) or the whole output (interlaced)
+    uint32_t sum_row;           // Output row held by the sums of a non-interlaced image
+} image_scaler_t;
+
+// Size of one side of an image reduced by `factor`, partial blocks count as a whole output pixel
+uint32_t scaled_size(uint32_t size, uint32_t factor);
+
+// Prepare to scale a width x height image of `layout` samples by 1/factor into `output`.
+// Only byte-aligned 8 and 16-bit samples can be scaled.
+bool begin_scaling(image_scaler_t &scaler, const pixel_layout_t &layout, bool big_endian, uint32_t width, uint32_t height, uint32_t factor, bool box_filter, bool interlaced,
+                   const image_view_t &output);
+
+// Whether any pixel of full-resolution row `y` is used (always true for box filtering)
+bool scaler_needs_row(const image_scaler_t &scaler, uint32_t y);
+
+// Add `count` converted pixels of full-resolution row `y`, located at columns x0, x0 + dx, x0 + 2 * dx, ...
+void scale_pixels(image_scaler_t &scaler, const uint8_t *pixels, uint32_t count, uint32_t x0, uint32_t dx, uint32_t y);
+
+// Write the output rows that are still accumulating, once every pixel has been added
+void finish_scaling(image_scaler_t &scaler);
+
+#endif // __IMAGE_SCALER_H__
@@ -0,0 +1,236 @@
+#include "inflate_backend.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <zlib.h>
+
+#ifndef EPL_DEFAULT_INFLATE_BACKEND
+#define EPL_DEFAULT_INFLATE_BACKEND INFLATE_ZLIB
+#endif
+
+#if defined(EPL_WITH_ZLIB_NG)
+extern const inflate_backend_t ZLIB_NG_INFLATE_BACKEND; // inflate_zlib_ng.cpp
+#endif
+#if defined(EPL_WITH_LIBDEFLATE)
+extern const inflate_backend_t LIBDEFLATE_INFLATE_BACKEND; // inflate_libdeflate.cpp
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+// zlib
+// ---------------------------------------------------------------------------------------------------------------------
+
+static bool zlib_inflate_buffer(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size, bool truncated)
+{
+    // zlib counts the input and output space with 32 bits
+    if (input_size > UINT_MAX || output_size > UINT_MAX)
+        return false;
+
+    z_stream stream = {};
+    if (inflateInit(&stream) != Z_OK)
+        return false;
+    stream.next_in = const_cast<Bytef *>(input);
+    stream.avail_in = static_cast<uInt>(input_size);
+    stream.next_out = output;
+    stream.avail_out = static_cast<uInt>(output_size);
+
+    // Decompress the data in a single call
+    int ret = inflate(&stream, Z_FINISH);
+    size_t total_out = stream.total_out;
+    inflateEnd(&stream);
+
+    // Z_BUF_ERROR here means the stream is either truncated or larger than the image (which is fine when only its start is wanted)
+    bool complete = ret == Z_STREAM_END || (truncated && (ret == Z_OK || ret == Z_BUF_ERROR));
+    return complete && total_out == output_size;
+}
+
+static void *zlib_stream_begin()
+{
+    z_stream *stream = new z_stream();
+    if (inflateInit(stream) != Z_OK)
+    {
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+static inflate_status_t zlib_stream_inflate(void *state, inflate_io_t &io)
+{
+    z_stream &stream = *static_cast<z_stream *>(state);
+    while (true)
+    {
+        // Windows larger than 4 GB are fed in slices
+        const uInt in = static_cast<uInt>(std::min<size_t>(io.avail_in, UINT_MAX));
+        const uInt out = static_cast<uInt>(std::min<size_t>(io.avail_out, UINT_MAX));
+        stream.next_in = const_cast<Bytef *>(io.next_in);
+        stream.avail_in = in;
+        stream.next_out = io.next_out;
+        stream.avail_out = out;
+
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        const size_t used_in = in - stream.avail_in;
+        const size_t used_out = out - stream.avail_out;
+        io.next_in += used_in;
+        io.avail_in -= used_in;
+        io.next_out += used_out;
+        io.avail_out -= used_out;
+
+        if (ret == Z_STREAM_END)
+            return INFLATE_STREAM_END;
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            return INFLATE_ERROR;
+        // A full output may still take the end of the stream, so only stop once no progress is made
+        if (io.avail_in == 0 || (used_in == 0 && used_out == 0))
+            return INFLATE_PROGRESS;
+    }
+}
+
+static bool zlib_stream_reset(void *state)
+{
+    return inflateReset(static_cast<z_stream *>(state)) == Z_OK;
+}
+
+static void zlib_stream_end(void *state)
+{
+    z_stream *stream = static_cast<z_stream *>(state);
+    inflateEnd(stream);
+    delete stream;
+}
+
+static const inflate_backend_t ZLIB_INFLATE_BACKEND = {
+    INFLATE_ZLIB, "zlib", zlib_inflate_buffer, true, zlib_stream_begin, zlib_stream_inflate, zlib_stream_reset, zlib_stream_end,
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Selection
+// ---------------------------------------------------------------------------------------------------------------------
+
+static std::atomic<inflate_backend_id_t> default_backend{EPL_DEFAULT_INFLATE_BACKEND};
+
+const inflate_backend_t *find_inflate_backend(inflate_backend_id_t id)
+{
+    if (id == INFLATE_AUTO)
+    {
+        // A build-time default that was not built in falls back to zlib
+        const inflate_backend_t *backend = find_inflate_backend(default_backend.load(std::memory_order_relaxed));
+        return backend != nullptr ? backend : &ZLIB_INFLATE_BACKEND;
+    }
+
+    switch (id)
+    {
+    case INFLATE_ZLIB:
+        return &ZLIB_INFLATE_BACKEND;
+#if defined(EPL_WITH_ZLIB_NG)
+    case INFLATE_ZLIB_NG:
+        return &ZLIB_NG_INFLATE_BACKEND;
+#endif
+#if defined(EPL_WITH_LIBDEFLATE)
+    case INFLATE_LIBDEFLATE:
+        return &LIBDEFLATE_INFLATE_BACKEND;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool prepare_inflate_stream(const inflate_backend_t *backend, const inflate_backend_t *&stream_backend, void *&stream)
+{
+    // Resetting keeps the inflate state and its 32 KB window, which is most of the setup cost of a small image
+    if (stream != nullptr && stream_backend == backend && backend->stream_reset(stream))
+        return true;
+
+    release_inflate_stream(stream_backend, stream);
+    stream = backend->stream_begin();
+    if (stream == nullptr)
+        return false;
+    stream_backend = backend;
+    return true;
+}
+
+void release_inflate_stream(const inflate_backend_t *&stream_backend, void *&stream)
+{
+    if (stream != nullptr)
+        stream_backend->stream_end(stream);
+    stream = nullptr;
+    stream_backend = nullptr;
+}
+
+std::vector<const inflate_backend_t *> available_inflate_backends()
+{
+    std::vector<const inflate_backend_t *> backends;
+    for (inflate_backend_id_t id : {INFLATE_ZLIB, INFLATE_ZLIB_NG, INFLATE_LIBDEFLATE})
+        if (const inflate_backend_t *backend = find_inflate_backend(id))
+            backends.push_back(backend);
+    return backends;
+}
+
+bool set_default_inflate_backend(inflate_backend_id_t id)
+{
+    if (id == INFLATE_AUTO || find_inflate_backend(id) == nullptr)
+        return false;
+    default_backend.store(id, std::memory_order_relaxed);
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Sub-filtered rows of a smooth RGB gradient with a little noise: compresses about like a photo run through a PNG encoder
+static std::vector<uint8_t> make_benchmark_image(size_t image_size)
+{
+    const size_t stride = 3 * 2048 + 1;
+    std::vector<uint8_t> image(std::max(image_size / stride, static_cast<size_t>(1)) * stride);
+    uint32_t seed = 12345;
+    for (size_t row = 0; row < image.size(); row += stride)
+    {
+        image[row] = 1;
+        for (size_t i = 1; i < stride; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            image[row + i] = static_cast<uint8_t>((i % 3 == 0 ? 1 : 0) + (seed >> 16) % 5 - 2);
+        }
+    }
+    return image;
+}
+
+std::vector<inflate_benchmark_t> benchmark_inflate_backends(size_t image_size)
+{
+    const std::vector<uint8_t> image = make_benchmark_image(image_size);
+    uLongf compressed_size = compressBound(image.size());
+    std::vector<uint8_t> compressed(compressed_size);
+    std::vector<inflate_benchmark_t> results;
+    if (compress2(compressed.data(), &compressed_size, image.data(), image.size(), 6) != Z_OK)
+        return results;
+
+    std::vector<uint8_t> output(image.size());
+    for (const inflate_backend_t *backend : available_inflate_backends())
+    {
+        // Best of a few runs, the first one also pays for page faults on the output
+        double best = INFINITY;
+        bool ok = true;
+        for (int run = 0; run < 4 && ok; run++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            ok = backend->inflate_buffer(compressed.data(), compressed_size, output.data(), output.size(), false);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            ok = ok && output == image;
+        }
+        if (ok)
+            results.push_back({backend, image.size() / best / 1e6});
+    }
+    return results;
+}
+
+inflate_backend_id_t select_fastest_inflate_backend()
+{
+    const std::vector<inflate_benchmark_t> results = benchmark_inflate_backends();
+    const auto fastest = std::max_element(results.begin(), results.end(),
+                                          [](const inflate_benchmark_t &a, const inflate_benchmark_t &b) { return a.megabytes_per_second < b.megabytes_per_second; });
+    if (fastest == results.end())
+        return find_inflate_backend(INFLATE_AUTO)->id;
+    set_default_inflate_backend(fastest->backend->id);
+    return fastest->backend->id;
+}
@@ -0,0 +1,82 @@
+#ifndef __INFLATE_BACKEND_H__
+#define __INFLATE_BACKEND_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// zlib stream decompressors the decoder can use. zlib is always built in, zlib-ng (native API) and libdeflate when
+// the build enables them (EPL_WITH_ZLIB_NG / EPL_WITH_LIBDEFLATE, see CMakeLists.txt).
+enum inflate_backend_id_t : uint8_t
+{
+    INFLATE_AUTO,       // The default backend: chosen at build time, or by select_fastest_inflate_backend()
+    INFLATE_ZLIB,
+    INFLATE_ZLIB_NG,
+    INFLATE_LIBDEFLATE, // Whole-buffer only: IDAT chunks are concatenated and inflated at IEND
+};
+
+// Input and output windows of a streaming inflate step, advanced by the backend
+typedef struct _inflate_io
+{
+    const uint8_t *next_in;
+    size_t avail_in;
+    uint8_t *next_out;
+    size_t avail_out;
+} inflate_io_t;
+
+enum inflate_status_t : uint8_t
+{
+    INFLATE_PROGRESS,    // All the input was consumed, or no more output fits
+    INFLATE_STREAM_END,  // The end of the zlib stream was reached
+    INFLATE_ERROR,       // Corrupt stream
+};
+
+// A backend is a table of functions, like the row converters
+typedef struct _inflate_backend
+{
+    inflate_backend_id_t id;
+    const char *name;
+
+    // Inflate a whole zlib stream into exactly `output_size` bytes. With `truncated`, the stream may be longer and
+    // only its first `output_size` bytes are wanted, which backends without supports_truncation cannot do.
+    bool (*inflate_buffer)(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size, bool truncated);
+    bool supports_truncation;
+
+    // Streaming state, nullptr for whole-buffer backends. stream_begin returns nullptr on failure.
+    // stream_reset rewinds a stream to decode another one, keeping its state and window allocations.
+    void *(*stream_begin)();
+    inflate_status_t (*stream_inflate)(void *state, inflate_io_t &io);
+    bool (*stream_reset)(void *state);
+    void (*stream_end)(void *state);
+} inflate_backend_t;
+
+// Make `stream` ready to inflate a new zlib stream with `backend`. A stream left by a previous image (of
+// `stream_backend`, nullptr if there is none) is reset when the backend is the same, and replaced otherwise.
+bool prepare_inflate_stream(const inflate_backend_t *backend, const inflate_backend_t *&stream_backend, void *&stream);
+
+// End a stream prepared by prepare_inflate_stream, if any
+void release_inflate_stream(const inflate_backend_t *&stream_backend, void *&stream);
+
+// Backend for an id (INFLATE_AUTO resolves to the default), nullptr if it was not built in
+const inflate_backend_t *find_inflate_backend(inflate_backend_id_t id);
+
+// Every backend built into this binary
+std::vector<const inflate_backend_t *> available_inflate_backends();
+
+// Make a backend the one INFLATE_AUTO resolves to (fails if it was not built in)
+bool set_default_inflate_backend(inflate_backend_id_t id);
+
+// Throughput of one backend on the benchmark stream
+typedef struct _inflate_benchmark
+{
+    const inflate_backend_t *backend;
+    double megabytes_per_second; // Decompressed bytes
+} inflate_benchmark_t;
+
+// Time every available backend on a synthetic filtered image of `image_size` bytes, compressed like a typical PNG encoder
+std::vector<inflate_benchmark_t> benchmark_inflate_backends(size_t image_size = 16 << 20);
+
+// Benchmark the backends and make the fastest one the default
+inflate_backend_id_t select_fastest_inflate_backend();
+
+#endif // __INFLATE_BACKEND_H__
@@ -0,0 +1,30 @@
+#include "inflate_backend.h"
+#include <libdeflate.h>
+
+// libdeflate only inflates whole buffers, which suits PNG: the decompressed size is known from IHDR
+static bool libdeflate_inflate_buffer(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size, bool truncated)
+{
+    // Allocating a decompressor costs more than inflating a small image, so every thread keeps one
+    struct decompressor_holder_t
+    {
+        libdeflate_decompressor *decompressor = libdeflate_alloc_decompressor();
+        ~decompressor_holder_t()
+        {
+            if (decompressor != nullptr)
+                libdeflate_free_decompressor(decompressor);
+        }
+    };
+    thread_local decompressor_holder_t holder;
+
+    // It cannot stop once the output is full, the whole stream must fit
+    if (truncated || holder.decompressor == nullptr)
+        return false;
+
+    size_t actual_size = 0;
+    return libdeflate_zlib_decompress(holder.decompressor, input, input_size, output, output_size, &actual_size) == LIBDEFLATE_SUCCESS && actual_size == output_size;
+}
+
+extern const inflate_backend_t LIBDEFLATE_INFLATE_BACKEND;
+const inflate_backend_t LIBDEFLATE_INFLATE_BACKEND = {
+    INFLATE_LIBDEFLATE, "libdeflate", libdeflate_inflate_buffer, false, nullptr, nullptr, nullptr, nullptr,
+};
@@ -0,0 +1,86 @@
+#include "inflate_backend.h"
+#include <algorithm>
+#include <cstdint>
+#include <zlib-ng.h>
+
+// zlib-ng through its native API (zng_ prefix), so it can be linked next to stock zlib
+static bool zlib_ng_inflate_buffer(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size, bool truncated)
+{
+    // zlib-ng counts the input and output space with 32 bits
+    if (input_size > UINT32_MAX || output_size > UINT32_MAX)
+        return false;
+
+    zng_stream stream = {};
+    if (zng_inflateInit(&stream) != Z_OK)
+        return false;
+    stream.next_in = input;
+    stream.avail_in = static_cast<uint32_t>(input_size);
+    stream.next_out = output;
+    stream.avail_out = static_cast<uint32_t>(output_size);
+
+    int ret = zng_inflate(&stream, Z_FINISH);
+    size_t total_out = stream.total_out;
+    zng_inflateEnd(&stream);
+
+    bool complete = ret == Z_STREAM_END || (truncated && (ret == Z_OK || ret == Z_BUF_ERROR));
+    return complete && total_out == output_size;
+}
+
+static void *zlib_ng_stream_begin()
+{
+    zng_stream *stream = new zng_stream();
+    if (zng_inflateInit(stream) != Z_OK)
+    {
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+static inflate_status_t zlib_ng_stream_inflate(void *state, inflate_io_t &io)
+{
+    zng_stream &stream = *static_cast<zng_stream *>(state);
+    while (true)
+    {
+        // Windows larger than 4 GB are fed in slices
+        const uint32_t in = static_cast<uint32_t>(std::min<size_t>(io.avail_in, UINT32_MAX));
+        const uint32_t out = static_cast<uint32_t>(std::min<size_t>(io.avail_out, UINT32_MAX));
+        stream.next_in = io.next_in;
+        stream.avail_in = in;
+        stream.next_out = io.next_out;
+        stream.avail_out = out;
+
+        int ret = zng_inflate(&stream, Z_NO_FLUSH);
+        const size_t used_in = in - stream.avail_in;
+        const size_t used_out = out - stream.avail_out;
+        io.next_in += used_in;
+        io.avail_in -= used_in;
+        io.next_out += used_out;
+        io.avail_out -= used_out;
+
+        if (ret == Z_STREAM_END)
+            return INFLATE_STREAM_END;
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            return INFLATE_ERROR;
+        // A full output may still take the end of the stream, so only stop once no progress is made
+        if (io.avail_in == 0 || (used_in == 0 && used_out == 0))
+            return INFLATE_PROGRESS;
+    }
+}
+
+static bool zlib_ng_stream_reset(void *state)
+{
+    return zng_inflateReset(static_cast<zng_stream *>(state)) == Z_OK;
+}
+
+static void zlib_ng_stream_end(void *state)
+{
+    zng_stream *stream = static_cast<zng_stream *>(state);
+    zng_inflateEnd(stream);
+    delete stream;
+}
+
+extern const inflate_backend_t ZLIB_NG_INFLATE_BACKEND;
+const inflate_backend_t ZLIB_NG_INFLATE_BACKEND = {
+    INFLATE_ZLIB_NG, "zlib-ng", zlib_ng_inflate_buffer, true, zlib_ng_stream_begin, zlib_ng_stream_inflate, zlib_ng_stream_reset, zlib_ng_stream_end,
+};
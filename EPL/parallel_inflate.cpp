@@ -0,0 +1,306 @@
+#include "parallel_inflate.h"
+#include "decode_log.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <zlib.h>
+
+// Compressed bytes a thread should get at least, smaller shares cost more in thread start-up than they save
+static const size_t MIN_SEGMENT_SIZE = 256 * 1024;
+
+// Bytes of the zlib header and of the adler32 trailer around the deflate data
+static const size_t ZLIB_HEADER_SIZE = 2;
+static const size_t ZLIB_TRAILER_SIZE = 4;
+
+void begin_parallel_inflate(parallel_inflater_t &inflater)
+{
+    inflater.idot.clear();
+    inflater.restart_points.clear();
+}
+
+void note_idat_chunk(parallel_inflater_t &inflater, const std::vector<uint8_t> &compressed, uint64_t chunk_offset, size_t row_size)
+{
+    // The empty stored block of a flush: LEN = 0, NLEN = 0xffff (the header bits before it cannot be told from data)
+    const size_t size = compressed.size();
+    if (size < ZLIB_HEADER_SIZE + 4 || compressed[size - 4] != 0x00 || compressed[size - 3] != 0x00 || compressed[size - 2] != 0xff || compressed[size - 1] != 0xff)
+        return;
+
+    size_t inflated_offset = UNKNOWN_INFLATED_OFFSET;
+    for (const idot_segment_t &segment : inflater.idot)
+        if (segment.chunk_offset == chunk_offset && segment.first_row != 0)
+            inflated_offset = static_cast<size_t>(segment.first_row) * row_size;
+    inflater.restart_points.push_back({size, inflated_offset});
+}
+
+// Whether a zlib header is one raw inflate can skip: deflate with a window zlib supports and no preset dictionary
+static bool valid_zlib_header(const std::vector<uint8_t> &compressed)
+{
+    if (compressed.size() < ZLIB_HEADER_SIZE + ZLIB_TRAILER_SIZE)
+        return false;
+    const uint8_t cmf = compressed[0];
+    const uint8_t flg = compressed[1];
+    return (cmf << 8 | flg) % 31 == 0 && (cmf & 0x0f) == 8 && (cmf >> 4) <= 7 && (flg & 0x20) == 0;
+}
+
+// Output of the segments inflating at once. Together they may not produce more than the image holds, so they all stop
+// as soon as they do, or as soon as one of them fails: the stream does not split and is inflated serially instead.
+typedef struct _segment_budget
+{
+    size_t max_size = 0;
+    std::atomic<size_t> produced = 0;
+    std::atomic<bool> failed = false;
+} segment_budget_t;
+
+// Raw-inflate one segment of deflate data into `output`, which grows from `size_hint` up to one byte past `max_size`
+// (so a segment too large for its share of the image is noticed). A segment that is not the last must use up its input
+// and stop byte-aligned at a block boundary before the final block; the last one must reach the end of the deflate stream.
+static bool inflate_one_segment(const uint8_t *input, size_t input_size, bool last, size_t size_hint, size_t max_size, segment_budget_t &budget,
+                                byte_buffer_t &output, size_t &unused_in)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+
+    output.resize(std::clamp<size_t>(size_hint, 1, max_size + 1));
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    int ret = Z_OK;
+    bool over_budget = false;
+    while (!budget.failed)
+    {
+        if (out_pos == output.size())
+        {
+            if (output.size() > max_size)
+                break;
+            output.resize(std::min(output.size() * 2, max_size + 1));
+        }
+
+        // Inputs and outputs larger than 4 GB are fed in slices
+        const uInt in = static_cast<uInt>(std::min<size_t>(input_size - in_pos, UINT_MAX));
+        const uInt out = static_cast<uInt>(std::min<size_t>(output.size() - out_pos, UINT_MAX));
+        stream.next_in = const_cast<Bytef *>(input + in_pos);
+        stream.avail_in = in;
+        stream.next_out = output.data() + out_pos;
+        stream.avail_out = out;
+
+        // Z_BLOCK stops at block boundaries, so data_type tells whether the segment ends on one
+        ret = inflate(&stream, last ? Z_NO_FLUSH : Z_BLOCK);
+        in_pos += in - stream.avail_in;
+        out_pos += out - stream.avail_out;
+        const size_t produced = out - stream.avail_out;
+        if (budget.produced.fetch_add(produced) + produced > budget.max_size)
+        {
+            over_budget = true;
+            break;
+        }
+        if (ret != Z_OK)
+            break;
+        // All the input is used and the output was not filled, so nothing is pending
+        if (in_pos == input_size && stream.avail_out != 0)
+            break;
+    }
+
+    // Bit 7: stopped at a block boundary, bit 6: in the final block, bits 0-5: unused bits of the last input byte
+    const bool at_restart_point = (stream.data_type & (128 | 64 | 63)) == 128;
+    inflateEnd(&stream);
+
+    output.resize(std::min(out_pos, output.size()));
+    unused_in = input_size - in_pos;
+    if (over_budget || budget.failed || out_pos > max_size)
+        return false;
+    return last ? ret == Z_STREAM_END : (ret == Z_OK || ret == Z_BUF_ERROR) && in_pos == input_size && at_restart_point;
+}
+
+static bool inflate_segment(const uint8_t *input, size_t input_size, bool last, size_t size_hint, size_t max_size, segment_budget_t &budget,
+                            byte_buffer_t &output, size_t &unused_in)
+{
+    bool inflated = false;
+    try
+    {
+        inflated = inflate_one_segment(input, input_size, last, size_hint, max_size, budget, output, unused_in);
+    }
+    catch (const std::bad_alloc &)
+    {
+        // Runs on a worker thread, where an exception would end the process: the serial path reports running out of memory
+    }
+    if (!inflated)
+        budget.failed = true;
+    return inflated;
+}
+bool inflate_segments(parallel_inflater_t &inflater, const std::vector<uint8_t> &compressed, size_t expected_size, uint32_t thread_count)
+{
+    const size_t size = compressed.size();
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const size_t count = std::min<size_t>(thread_count, size / MIN_SEGMENT_SIZE);
+    if (count < 2 || inflater.restart_points.empty() || !valid_zlib_header(compressed))
+        return false;
+
+    // Segment k is [starts[k], starts[k + 1]) of the stream, the first starts after the zlib header and the last ends with it
+    std::vector<restart_point_t> starts = {{ZLIB_HEADER_SIZE, 0}};
+    for (size_t i = 1; i < count; i++)
+    {
+        const size_t target = size * i / count;
+        auto point = std::find_if(inflater.restart_points.begin(), inflater.restart_points.end(), [&](const restart_point_t &p) {
+            return p.compressed_offset >= target && p.compressed_offset > starts.back().compressed_offset && p.compressed_offset < size - ZLIB_TRAILER_SIZE;
+        });
+        if (point != inflater.restart_points.end())
+            starts.push_back(*point);
+    }
+    const size_t segment_count = starts.size();
+    if (segment_count < 2)
+        return false;
+    EPL_LOG(LOG_DEBUG, "Inflating " << segment_count << " segments in parallel");
+
+    // A segment holds no more than the bytes between the closest known offsets around it (the whole image without any),
+    // and all of them together no more than the image: none grows past what a valid stream gives it
+    std::vector<size_t> max_sizes(segment_count);
+    for (size_t k = 0; k < segment_count; k++)
+    {
+        size_t first = 0;
+        size_t last = expected_size;
+        for (size_t j = 0; j < segment_count; j++)
+            if (starts[j].inflated_offset != UNKNOWN_INFLATED_OFFSET)
+            {
+                if (j <= k)
+                    first = std::max(first, starts[j].inflated_offset);
+                else
+                    last = std::min(last, starts[j].inflated_offset);
+            }
+        max_sizes[k] = last > first ? last - first : 0;
+    }
+    segment_budget_t budget;
+    budget.max_size = expected_size;
+
+    std::vector<byte_buffer_t> &segments = inflater.segments;
+    segments.resize(segment_count);
+    std::vector<char> inflated(segment_count, 0); // Not vector<bool>, the threads write neighbouring entries
+    std::vector<uLong> checksums(segment_count, 0);
+    size_t unused_in = 0;
+    auto inflate_one = [&](size_t k) {
+        const size_t begin = starts[k].compressed_offset;
+        const size_t end = k + 1 < segment_count ? starts[k + 1].compressed_offset : size;
+        const bool last = k + 1 == segment_count;
+
+        // Guess the size from the share of the compressed data, it is exact between two iDOT restart points
+        size_t size_hint = static_cast<size_t>(static_cast<double>(expected_size) * (end - begin) / size * 1.125);
+        if (!last && starts[k].inflated_offset != UNKNOWN_INFLATED_OFFSET && starts[k + 1].inflated_offset != UNKNOWN_INFLATED_OFFSET)
+            size_hint = starts[k + 1].inflated_offset - starts[k].inflated_offset + 1;
+
+        size_t unused = 0;
+        inflated[k] = inflate_segment(compressed.data() + begin, end - begin, last, size_hint, max_sizes[k], budget, segments[k], unused);
+        if (inflated[k])
+            checksums[k] = adler32_z(1, segments[k].data(), segments[k].size());
+        if (last)
+            unused_in = unused;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(segment_count - 1);
+    for (size_t k = 1; k < segment_count; k++)
+        threads.emplace_back(inflate_one, k);
+    inflate_one(0);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    // Every segment must have inflated where the stream says it starts, and the pieces must add up to the zlib checksum
+    bool split = std::find(inflated.begin(), inflated.end(), 0) == inflated.end() && unused_in >= ZLIB_TRAILER_SIZE;
+    size_t offset = 0;
+    uLong checksum = 0;
+    for (size_t k = 0; k < segment_count && split; k++)
+    {
+        split = starts[k].inflated_offset == UNKNOWN_INFLATED_OFFSET || starts[k].inflated_offset == offset;
+        checksum = k == 0 ? checksums[0] : adler32_combine(checksum, checksums[k], static_cast<z_off_t>(segments[k].size()));
+        offset += segments[k].size();
+    }
+    if (split)
+    {
+        const uint8_t *trailer = compressed.data() + size - unused_in;
+        split = offset == expected_size && checksum == (static_cast<uLong>(trailer[0]) << 24 | trailer[1] << 16 | trailer[2] << 8 | trailer[3]);
+    }
+    if (!split)
+    {
+        // Freed before the serial path allocates the whole image
+        EPL_LOG(LOG_DEBUG, "Segments do not inflate on their own, inflating serially");
+        segments.clear();
+    }
+    return split;
+}
+
+// Push the scanlines of segments [first, end), which start at the decoder's current row
+static bool unfilter_band(scanline_decoder_t &decoder, const std::vector<byte_buffer_t> &segments, size_t first, size_t end)
+{
+    const size_t row_size = decoder.pass_stride + 1;
+    for (size_t k = first; k < end; k++)
+        for (size_t offset = 0; offset < segments[k].size(); offset += row_size)
+            if (!push_scanline(decoder, segments[k].data() + offset))
+                return false;
+    return true;
+}
+
+bool unfilter_segments(parallel_inflater_t &inflater, scanline_decoder_t &decoder)
+{
+    const std::vector<byte_buffer_t> &segments = inflater.segments;
+    const size_t row_size = decoder.pass_stride + 1;
+
+    // Bands start at segment 0 and at every segment whose first scanline does not look at the row above it
+    std::vector<size_t> band_starts;
+    size_t offset = 0;
+    bool row_aligned = true;
+    for (size_t k = 0; k < segments.size(); k++)
+    {
+        row_aligned &= offset % row_size == 0;
+        if (k == 0 || (!segments[k].empty() && segments[k][0] <= 1))
+            band_starts.push_back(k);
+        offset += segments[k].size();
+    }
+
+    if (!row_aligned)
+    {
+        EPL_LOG(LOG_DEBUG, "Segments do not end on scanline boundaries, unfiltering serially");
+        byte_buffer_t &joined = inflater.joined;
+        joined.resize(offset);
+        uint8_t *dst = joined.data();
+        for (const byte_buffer_t &segment : segments)
+        {
+            std::memcpy(dst, segment.data(), segment.size());
+            dst += segment.size();
+        }
+        return push_scanlines(decoder, joined.data(), joined.size());
+    }
+
+    // The bands run at once, their wall time is counted as unfiltering (conversion included)
+    EPL_TIME_STAGE(decoder.stats, DECODE_STAGE_UNFILTER);
+    decode_stats_t *stats = decoder.stats;
+    decoder.stats = nullptr;
+
+    const size_t band_count = band_starts.size();
+    EPL_LOG(LOG_DEBUG, "Unfiltering " << band_count << " bands in parallel");
+    std::vector<scanline_decoder_t> band_decoders(band_count - 1, decoder);
+    std::vector<char> unfiltered(band_count, 0);
+    auto unfilter_one = [&](size_t b) {
+        const size_t end = b + 1 < band_count ? band_starts[b + 1] : segments.size();
+        scanline_decoder_t &band_decoder = b == 0 ? decoder : band_decoders[b - 1];
+        size_t first_row = 0;
+        for (size_t k = 0; k < band_starts[b]; k++)
+            first_row += segments[k].size() / row_size;
+        unfiltered[b] = (b == 0 || seek_scanline(band_decoder, static_cast<uint32_t>(first_row))) && unfilter_band(band_decoder, segments, band_starts[b], end);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(band_count - 1);
+    for (size_t b = 1; b < band_count; b++)
+        threads.emplace_back(unfilter_one, b);
+    unfilter_one(0);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    decoder.stats = stats;
+    decoder.bytes_left = 0;
+    decoder.finished = true;
+    return std::find(unfiltered.begin(), unfiltered.end(), 0) == unfiltered.end();
+}
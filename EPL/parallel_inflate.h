@@ -0,0 +1,57 @@
+#ifndef __PARALLEL_INFLATE_H__
+#define __PARALLEL_INFLATE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_buffer.h"
+#include "scanline_decoder.h"
+
+// Offset of a restart point in the decompressed stream when only inflating the data before it would tell
+static const size_t UNKNOWN_INFLATED_OFFSET = SIZE_MAX;
+
+// A point of the concatenated IDAT data where inflating can start over: the stream before it ends with a full flush
+// (an empty stored block, 00 00 FF FF), so it is byte-aligned there and nothing after it refers back across it
+typedef struct _restart_point
+{
+    size_t compressed_offset;
+    size_t inflated_offset; // Known from an iDOT chunk, UNKNOWN_INFLATED_OFFSET for other flush markers
+} restart_point_t;
+
+// Band of rows of an iDOT chunk (written by Apple's encoder), compressed on its own and starting with a new IDAT chunk
+typedef struct _idot_segment
+{
+    uint32_t first_row;
+    uint32_t row_count;
+    uint64_t chunk_offset; // File offset of the IDAT chunk it starts with
+} idot_segment_t;
+
+// Inflating and unfiltering the IDAT data of one image on several threads, from its restart points.
+// Kept in the decoder context so the segment buffers are reused.
+typedef struct _parallel_inflater
+{
+    std::vector<idot_segment_t> idot;            // From the iDOT chunk, empty without one
+    std::vector<restart_point_t> restart_points; // Found while the IDAT chunks are gathered
+    std::vector<byte_buffer_t> segments;         // Decompressed scanlines of every segment, in stream order
+    byte_buffer_t joined;                        // Segments concatenated, when scanlines straddle their boundaries
+} parallel_inflater_t;
+
+// Forget the iDOT chunk and restart points of the previous image
+void begin_parallel_inflate(parallel_inflater_t &inflater);
+
+// Record a restart point at the IDAT chunk found at `chunk_offset` in the file, before its data is appended to the
+// gathered `compressed` stream, when that stream ends with a full-flush marker. `row_size` includes the filter type byte.
+void note_idat_chunk(parallel_inflater_t &inflater, const std::vector<uint8_t> &compressed, uint64_t chunk_offset, size_t row_size);
+
+// Inflate the gathered zlib stream into `expected_size` bytes on up to `thread_count` threads (0: one per hardware
+// thread), a segment per thread, splitting it at the restart points closest to even shares. Returns false when it cannot be split (no restart point, a stream too small to be worth it,
+// or a segment that does not inflate on its own): the caller then inflates it serially, which also reports a corrupt stream.
+bool inflate_segments(parallel_inflater_t &inflater, const std::vector<uint8_t> &compressed, size_t expected_size, uint32_t thread_count);
+
+// Unfilter and convert the inflated segments through `decoder`, prepared for a whole non-interlaced image. Segments
+// starting a band whose first scanline is not predicted from the row above (filter type None or Sub) are decoded in
+// parallel, each band by its own copy of the decoder. Segments that do not end on a scanline boundary are joined first.
+bool unfilter_segments(parallel_inflater_t &inflater, scanline_decoder_t &decoder);
+
+#endif // __PARALLEL_INFLATE_H__
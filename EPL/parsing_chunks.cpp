@@ -1,19 +1,64 @@
 #include "parsing_chunks.h"
+#include "decode_log.h"
+#include "fused_inflater.h"
+#include "parallel_inflate.h"
 #include <cassert>
 #include <cstring>
-#include <fstream>
 #include <iostream>
+#include <new>
 #include <sstream>
-#include <zlib.h> // For CRC32 calculation
+#include <zlib.h>
 
-bool parse_ihdr_chunk(std::ifstream &stream, uint32_t chunk_length, IHDR_t &ihdr)
+// Text chunks are small, anything inflating past this is treated as corrupt (or as a decompression bomb)
+static const size_t MAX_TEXT_SIZE = 1 << 24;
+
+// Split the null-terminated keyword off the start of a text chunk, returns the offset of the byte after the separator
+static bool read_keyword(std::span<const uint8_t> data, std::string &keyword, size_t &next)
 {
-    // IHDR chunk must be 13 bytes long (this is specified by the PNG standard)
-    assert(chunk_length == 13);
+    const uint8_t *end = static_cast<const uint8_t *>(std::memchr(data.data(), 0, data.size()));
+    if (end == nullptr || end == data.data() || end - data.data() > 79)
+        return false;
+    keyword.assign(reinterpret_cast<const char *>(data.data()), end - data.data());
+    next = static_cast<size_t>(end - data.data()) + 1;
+    return true;
+}
+
+// Inflate the compressed text of a zTXt / iTXt chunk, the zlib state and window come from the scratch arena
+static bool inflate_text(const uint8_t *data, size_t size, std::string &text, scratch_arena_t &scratch)
+{
+    z_stream stream = {};
+    stream.zalloc = scratch_zalloc;
+    stream.zfree = scratch_zfree;
+    stream.opaque = &scratch;
+    if (inflateInit(&stream) != Z_OK)
+        return false;
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+
+    int ret = Z_OK;
+    char block[4096];
+    while (ret == Z_OK && text.size() <= MAX_TEXT_SIZE)
+    {
+        stream.next_out = reinterpret_cast<Bytef *>(block);
+        stream.avail_out = sizeof(block);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        text.append(block, sizeof(block) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
 
-    // Prepare a buffer to store the chunk data (13 bytes) and the CRC value (4 bytes)
-    uint8_t buffer[chunk_length + 4]; // 13 bytes for IHDR data, 4 bytes for CRC
-    stream.read(reinterpret_cast<char *>(buffer), chunk_length + 4);
+bool parse_ihdr_chunk(std::span<const uint8_t> buffer, IHDR_t &ihdr)
+{
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
+
+    // IHDR chunk must be 13 bytes long (this is specified by the PNG standard)
+    if (chunk_length != 13)
+    {
+        std::cerr << "Error: Invalid IHDR chunk length!" << std::endl;
+        return false;
+    }
 
     // Extract the width and height from the buffer (both are 4-byte big-endian integers)
     // PNG data is stored in big-endian, so we manually convert it to little-endian here
@@ -39,228 +84,284 @@ bool parse_ihdr_chunk(std::ifstream &stream, uint32_t chunk_length, IHDR_t &ihdr
     // Read interlace method (1 byte)
     ihdr.interlace_method = buffer[12];
 
-    // Determine the number of channels based on the color type
+    // Both dimensions are at most 2^31 - 1 and at least 1
+    if (ihdr.width == 0 || ihdr.height == 0 || ihdr.width > 0x7fffffff || ihdr.height > 0x7fffffff)
+    {
+        std::cerr << "Error: Invalid image size " << ihdr.width << "x" << ihdr.height << "!" << std::endl;
+        return false;
+    }
+
+    // Determine the number of channels based on the color type, and which bit depths it allows
+    bool depth_allowed;
+    const uint8_t depth = ihdr.bit_depth;
     switch (ihdr.color_type)
     {
     case 0: // Grayscale
         ihdr.channels = 1;
+        depth_allowed = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
         break;
     case 2: // Truecolor (RGB)
         ihdr.channels = 3;
+        depth_allowed = depth == 8 || depth == 16;
         break;
     case 3: // Indexed-color (Palette)
         ihdr.channels = 1;
+        depth_allowed = depth == 1 || depth == 2 || depth == 4 || depth == 8;
         break;
     case 4: // Grayscale with alpha
         ihdr.channels = 2;
+        depth_allowed = depth == 8 || depth == 16;
         break;
     case 6: // Truecolor with alpha (RGBA)
         ihdr.channels = 4;
+        depth_allowed = depth == 8 || depth == 16;
         break;
     default:
-        std::cerr << "Error: Parse IHDR chunk - CRC mismatch!" << std::endl;
-        ihdr.channels = 0; // Invalid color type
-        break;
+        std::cerr << "Error: Invalid IHDR color type " << static_cast<int>(ihdr.color_type) << "!" << std::endl;
+        ihdr.channels = 0;
+        return false;
+    }
+    if (!depth_allowed)
+    {
+        std::cerr << "Error: Invalid bit depth " << static_cast<int>(depth) << " for IHDR color type " << static_cast<int>(ihdr.color_type) << "!" << std::endl;
+        return false;
     }
-    // Ensure that the color type is valid and channels is not zero
-    assert(ihdr.channels != 0);
-
-    // Extract the CRC value from the buffer (last 4 bytes)
-    uint32_t crc_value = buffer[chunk_length] << 24 | buffer[chunk_length + 1] << 16 | buffer[chunk_length + 2] << 8 | buffer[chunk_length + 3] << 0;
-
-    // Calculate the CRC for the IHDR chunk data (including the chunk type "IHDR")
-    // CRC-32 computed over the chunk type and chunk data, but not the length.
-    const char chunk_type[4] = {'I', 'H', 'D', 'R'};
-    uint32_t crc_integrity = crc32(0L, (uint8_t *)chunk_type, 4);          // Start with "IHDR" type
-    crc_integrity = crc32(crc_integrity, (uint8_t *)buffer, chunk_length); // Continue with chunk data
 
-    if (crc_integrity != crc_value)
+    // Deflate, adaptive filtering and no or Adam7 interlacing are the only methods the standard defines
+    if (ihdr.compression_method != 0 || ihdr.filter_method != 0 || ihdr.interlace_method > 1)
     {
-        std::cerr << "Error: Parse IHDR chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Unknown IHDR compression, filter or interlace method!" << std::endl;
+        return false;
     }
+
     // If everything is correct, return true
-    std::cout << "Parse IHDR chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse IHDR chunk successfully!");
     return true;
 }
 
-bool parse_plte_chunk(std::ifstream &stream, uint32_t chunk_length, std::vector<RGB_t> &palette)
+bool parse_plte_chunk(std::span<const uint8_t> buffer, std::vector<RGB_t> &palette)
 {
-    // PLTE chunk must be a multiple of 3 (since each color is represented by 3 bytes: R, G, B)
-    assert(chunk_length % 3 == 0);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // PLTE chunk must be a multiple of 3 (since each color is represented by 3 bytes: R, G, B)
+    // and at most 256 entries can be indexed, even with 8-bit samples
+    if (chunk_length == 0 || chunk_length % 3 != 0 || chunk_length > 256 * 3)
+    {
+        std::cerr << "Error: Invalid PLTE chunk length!" << std::endl;
+        return false;
+    }
 
-    // Extract the RGB values and store them in the palette vector
+    // Extract the RGB values and store them in the palette vector, allocating it once
+    palette.clear();
+    palette.reserve(chunk_length / 3);
     for (uint32_t i = 0; i < chunk_length; i += 3)
     {
         palette.emplace_back(buffer[i], buffer[i + 1], buffer[i + 2]);
     }
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "PLTE" chunk type)
-    const char chunk_type[4] = {'P', 'L', 'T', 'E'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "PLTE"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse PLTE chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse PLTE chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse PLTE chunk successfully!");
     return true;
 }
 
-bool parse_idat_chunk(std::ifstream &stream, uint32_t chunk_length, std::vector<uint8_t> &compressed_data)
+bool parse_idat_chunk(std::span<const uint8_t> buffer, std::vector<uint8_t> &compressed_data)
 {
-    assert(chunk_length > 0);
-    // Read the compressed data
-    std::vector<uint8_t> buffer(chunk_length + 4);
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
+    // Empty IDAT chunks are valid, they add nothing to the stream
     // Append the current chunk's data to the compressed_data vector
     compressed_data.insert(compressed_data.end(), buffer.begin(), buffer.end() - 4);
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // If everything is correct, return true
+    EPL_LOG(LOG_DEBUG, "Parse IDAT chunk successfully! - chunk_length: " << chunk_length);
+    return true;
+}
+
+bool decompress_idat_data(const std::vector<uint8_t> &compressed_data, size_t expected_size, byte_buffer_t &decompressed_data, bool truncated, const inflate_backend_t *backend)
+{
+    if (backend == nullptr)
+        backend = find_inflate_backend(INFLATE_AUTO);
+    if (truncated && !backend->supports_truncation)
+        backend = find_inflate_backend(INFLATE_ZLIB);
 
-    // Calculate the CRC of the chunk data (including the "IDAT" chunk type)
-    const char chunk_type[4] = {'I', 'D', 'A', 'T'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "IDAT"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The decompressed size is known from the IHDR geometry, so allocate it once without zero-filling
+    try
+    {
+        decompressed_data.resize(expected_size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Error: Out of memory allocating " << expected_size << " bytes of image data!" << std::endl;
+        return false;
+    }
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // Decompress the data in a single call
+    if (!backend->inflate_buffer(compressed_data.data(), compressed_data.size(), decompressed_data.data(), expected_size, truncated))
     {
-        std::cerr << "Error: Parse IDAT chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error during decompression - IDAT stream does not match the image size." << std::endl;
+        decompressed_data.clear();
+        return false;
     }
-    // If everything is correct, return true
-    std::cout << "Parse IDAT chunk successfully! - "
-              << "chunk_lenght: " << chunk_length << std::endl;
     return true;
 }
 
-std::vector<uint8_t> decompress_idat_data(const std::vector<uint8_t> &compressed_data)
+bool parse_idat_chunk(std::span<const uint8_t> buffer, idat_inflater_t &inflater)
 {
-    // Set up the zlib stream
-    z_stream zlib_stream;
-    zlib_stream.zalloc = Z_NULL;
-    zlib_stream.zfree = Z_NULL;
-    zlib_stream.opaque = Z_NULL;
-    zlib_stream.avail_in = compressed_data.size();
-    zlib_stream.next_in = const_cast<uint8_t *>(compressed_data.data());
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Initialize zlib for decompression
-    if (inflateInit(&zlib_stream) != Z_OK)
-    {
-        std::cerr << "Error initializing zlib." << std::endl;
-        return {};
-    }
+    // Empty IDAT chunks are valid, they add nothing to the stream
+    // Inflate the current chunk's data right away
+    if (!feed_idat_data(inflater, buffer.data(), chunk_length))
+        return false;
 
-    // Output buffer for decompressed data
-    std::vector<uint8_t> decompressed_data(1024 * 1024); // 1 MB initial buffer size (resize later if necessary)
+    // If everything is correct, return true
+    EPL_LOG(LOG_DEBUG, "Parse IDAT chunk successfully! - chunk_length: " << chunk_length);
+    return true;
+}
 
-    // Decompress the data
-    int ret;
-    do
-    {
-        zlib_stream.avail_out = decompressed_data.size() - zlib_stream.total_out;
-        zlib_stream.next_out = decompressed_data.data() + zlib_stream.total_out;
+bool parse_idat_chunk(std::span<const uint8_t> buffer, fused_inflater_t &inflater)
+{
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-        ret = inflate(&zlib_stream, Z_NO_FLUSH);
-        if (ret == Z_BUF_ERROR)
-        {
-            // Increase buffer size if necessary
-            decompressed_data.resize(decompressed_data.size() * 2);
-        }
-    } while (ret != Z_STREAM_END && ret != Z_MEM_ERROR);
+    // Empty IDAT chunks are valid, they add nothing to the stream
+    // Inflate the current chunk's data and unfilter its rows right away
+    if (!feed_fused_inflate(inflater, buffer.data(), chunk_length))
+        return false;
 
-    // Resize the buffer to the actual decompressed size
-    decompressed_data.resize(zlib_stream.total_out);
+    // If everything is correct, return true
+    EPL_LOG(LOG_DEBUG, "Parse IDAT chunk successfully! - chunk_length: " << chunk_length);
+    return true;
+}
+
+_idat_inflater::~_idat_inflater()
+{
+    release_inflate_stream(backend, stream);
+}
 
-    // Clean up zlib resources
-    inflateEnd(&zlib_stream);
+bool begin_idat_inflate(idat_inflater_t &inflater, size_t expected_size, bool truncated, const inflate_backend_t *backend)
+{
+    if (backend == nullptr)
+        backend = find_inflate_backend(INFLATE_AUTO);
+    assert(backend->stream_begin != nullptr);
 
-    if (ret != Z_STREAM_END)
+    // Initialize the backend for decompression, an inflater reused across images resets its stream instead
+    if (!prepare_inflate_stream(backend, inflater.backend, inflater.stream))
     {
-        std::cerr << "Error during decompression." << std::endl;
-        return {};
+        std::cerr << "Error initializing " << backend->name << "." << std::endl;
+        return false;
     }
+    inflater.initialized = true;
+    inflater.finished = false;
+    inflater.truncated = truncated;
 
-    return decompressed_data;
+    // Output buffer for decompressed data, allocated once and left uninitialized
+    try
+    {
+        inflater.output.resize(expected_size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Error: Out of memory allocating " << expected_size << " bytes of image data!" << std::endl;
+        return false;
+    }
+    inflater.output_used = 0;
+    return true;
 }
 
-bool parse_iend_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool feed_idat_data(idat_inflater_t &inflater, const uint8_t *data, size_t size)
 {
-    // The IEND chunk should always have a length of 0
-    assert(chunk_length == 0);
-
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    assert(inflater.initialized);
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // Data after the end of the zlib stream is ignored
+    if (inflater.finished)
+        return true;
 
-    // Calculate the CRC of the chunk data (including the "IEND" chunk type)
-    const char chunk_type[4] = {'I', 'E', 'N', 'D'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4); // Start with the chunk type "IEND"
+    inflate_io_t io = {data, size, inflater.output.data() + inflater.output_used, inflater.output.size() - inflater.output_used};
+    inflate_status_t status = inflater.backend->stream_inflate(inflater.stream, io);
+    inflater.output_used = inflater.output.size() - io.avail_out;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    if (status == INFLATE_STREAM_END || (inflater.truncated && io.avail_out == 0))
     {
-        std::cerr << "Error: Parse IEND chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        inflater.finished = true;
+        return true;
+    }
+    if (status == INFLATE_ERROR)
+    {
+        std::cerr << "Error during decompression." << std::endl;
+        return false;
+    }
+    if (io.avail_in > 0)
+    {
+        std::cerr << "Error during decompression - IDAT stream is larger than the image." << std::endl;
+        return false;
     }
-    // If everything is correct, return true
-    std::cout << "Parse IEND chunk successfully!" << std::endl;
     return true;
 }
 
-bool parse_bkgd_chunk(std::ifstream &stream, uint32_t chunk_length, bKGD_t &bkgd_color)
+bool finish_idat_inflate(idat_inflater_t &inflater, byte_buffer_t &decompressed_data)
 {
-    assert((chunk_length == 1) || (chunk_length == 6));
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    if (!inflater.finished || inflater.output_used != inflater.output.size())
+    {
+        std::cerr << "Error during decompression - IDAT stream does not match the image size." << std::endl;
+        return false;
+    }
+    // The previous decompressed buffer becomes the next output, so a reused inflater and properties stop allocating
+    decompressed_data.swap(inflater.output);
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The backend stream is kept for the next image, the destructor releases it
+    inflater.initialized = false;
+    return true;
+}
 
-    // Calculate the CRC of the chunk data (including the "bKGD" chunk type)
-    const char chunk_type[4] = {'b', 'K', 'G', 'D'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "bKGD"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+bool parse_iend_chunk(std::span<const uint8_t> buffer)
+{
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // The IEND chunk should always have a length of 0
+    if (chunk_length != 0)
     {
-        std::cerr << "Error: Parse bKGD chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Invalid IEND chunk length!" << std::endl;
+        return false;
     }
 
+    // If everything is correct, return true
+    EPL_LOG(LOG_DEBUG, "Parse IEND chunk successfully!");
+    return true;
+}
+
+bool parse_bkgd_chunk(std::span<const uint8_t> buffer, uint8_t bit_depth, bKGD_t &bkgd_color)
+{
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
+
+    // Gray and RGB samples are 2 bytes each whatever the bit depth, kept as 8 bits (the high byte of 16-bit samples)
+    auto read_sample = [&](size_t offset) { return static_cast<uint8_t>(bit_depth == 16 ? buffer[offset] : buffer[offset + 1]); };
+
     // Parse the background color data based on the chunk length
     if (chunk_length == 1) // Indexed-color image
     {
         bkgd_color.index = buffer[0];
         bkgd_color.is_indexed = true;
-        std::cout << "Background color index: " << static_cast<int>(bkgd_color.index) << std::endl;
+        EPL_LOG(LOG_INFO, "Background color index: " << static_cast<int>(bkgd_color.index));
+    }
+    else if (chunk_length == 2) // Grayscale image, with or without alpha
+    {
+        bkgd_color.red = bkgd_color.green = bkgd_color.blue = read_sample(0);
+        bkgd_color.is_indexed = false;
+        EPL_LOG(LOG_INFO, "Background color (gray): " << static_cast<int>(bkgd_color.red));
     }
     else if (chunk_length == 6) // Truecolor image
     {
-        bkgd_color.red = buffer[0];
-        bkgd_color.green = buffer[1];
-        bkgd_color.blue = buffer[2];
+        bkgd_color.red = read_sample(0);
+        bkgd_color.green = read_sample(2);
+        bkgd_color.blue = read_sample(4);
         bkgd_color.is_indexed = false;
-        std::cout << "Background color (RGB): (" << static_cast<int>(bkgd_color.red) << ", " << static_cast<int>(bkgd_color.green) << ", " << static_cast<int>(bkgd_color.blue) << ")" << std::endl;
+        EPL_LOG(LOG_INFO, "Background color (RGB): (" << static_cast<int>(bkgd_color.red) << ", " << static_cast<int>(bkgd_color.green) << ", " << static_cast<int>(bkgd_color.blue) << ")");
     }
     else
     {
@@ -269,31 +370,20 @@ bool parse_bkgd_chunk(std::ifstream &stream, uint32_t chunk_length, bKGD_t &bkgd
     }
 
     // If everything is correct, return true
-    std::cout << "Parse bKGD chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse bKGD chunk successfully!");
     return true;
 }
 
-bool parse_chrm_chunk(std::ifstream &stream, uint32_t chunk_length, cHRM_t &chrm)
+bool parse_chrm_chunk(std::span<const uint8_t> buffer, cHRM_t &chrm)
 {
-    assert(chunk_length == 32);
-
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Calculate the CRC of the chunk data (including the "cHRM" chunk type)
-    const char chunk_type[4] = {'c', 'H', 'R', 'M'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "cHRM"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // cHRM chunk must be 32 bytes long: 8 four-byte coordinates
+    if (chunk_length != 32)
     {
-        std::cerr << "Error: Parse cHRM chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Invalid cHRM chunk length!" << std::endl;
+        return false;
     }
 
     // Extract the chromaticity coordinates (converting from big-endian to uint32_t)
@@ -307,193 +397,160 @@ bool parse_chrm_chunk(std::ifstream &stream, uint32_t chunk_length, cHRM_t &chrm
     chrm.white_y = (buffer[28] << 24) | (buffer[29] << 16) | (buffer[30] << 8) | buffer[31];
 
     // If everything is correct, return true
-    std::cout << "Parse cHRM chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse cHRM chunk successfully!");
     return true;
 }
 
-bool parse_cicp_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_cicp_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "cICP" chunk type)
-    const char chunk_type[4] = {'c', 'I', 'C', 'P'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "cICP"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse cICP chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse cICP chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse cICP chunk successfully!");
     return true;
 }
 
-bool parse_dsig_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_dsig_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Calculate the CRC of the chunk data (including the "dSIG" chunk type)
-    const char chunk_type[4] = {'d', 'S', 'I', 'G'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "dSIG"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse dSIG chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse dSIG chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse dSIG chunk successfully!");
     return true;
 }
 
-bool parse_exif_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_exif_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "eXIf" chunk type)
-    const char chunk_type[4] = {'e', 'X', 'I', 'f'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "eXIf"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse eXIf chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse eXIf chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse eXIf chunk successfully!");
     return true;
 }
 
-bool parse_gama_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_gama_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Calculate the CRC of the chunk data (including the "gAMA" chunk type)
-    const char chunk_type[4] = {'g', 'A', 'M', 'A'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "gAMA"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse gAMA chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse gAMA chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse gAMA chunk successfully!");
     return true;
 }
 
-bool parse_hist_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_hist_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "hIST" chunk type)
-    const char chunk_type[4] = {'h', 'I', 'S', 'T'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "hIST"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse hIST chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse hIST chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse hIST chunk successfully!");
     return true;
 }
 
-bool parse_iccp_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_iccp_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // If everything is correct, return true
+    EPL_LOG(LOG_DEBUG, "Parse iCCP chunk successfully!");
+    return true;
+}
 
-    // Calculate the CRC of the chunk data (including the "iCCP" chunk type)
-    const char chunk_type[4] = {'i', 'C', 'C', 'P'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "iCCP"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+bool parse_idot_chunk(std::span<const uint8_t> buffer, uint64_t chunk_offset, const IHDR_t &ihdr, std::vector<idot_segment_t> &segments)
+{
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
+    auto read_u32 = [&](size_t offset) { return static_cast<uint32_t>(buffer[offset] << 24 | buffer[offset + 1] << 16 | buffer[offset + 2] << 8 | buffer[offset + 3]); };
+
+    // A segment count, then the first row, row count and IDAT chunk offset (from the start of this chunk) of every segment
+    segments.clear();
+    const uint32_t count = chunk_length >= 4 ? read_u32(0) : 0;
+    if (count == 0 || count > (chunk_length - 4) / 12 || chunk_length != 4 + 12 * count)
+    {
+        EPL_LOG(LOG_DEBUG, "Ignore iDOT chunk: unexpected length");
+        return true;
+    }
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // The bands must cover the image from top to bottom, a chunk that does not is only a hint that is not followed
+    uint32_t next_row = 0;
+    for (uint32_t i = 0; i < count; i++)
     {
-        std::cerr << "Error: Parse iCCP chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        const uint32_t first_row = read_u32(4 + 12 * i);
+        const uint32_t row_count = read_u32(8 + 12 * i);
+        if (first_row != next_row || row_count == 0 || row_count > ihdr.height - first_row)
+        {
+            segments.clear();
+            EPL_LOG(LOG_DEBUG, "Ignore iDOT chunk: segments do not cover the image");
+            return true;
+        }
+        segments.push_back({first_row, row_count, chunk_offset + read_u32(12 + 12 * i)});
+        next_row += row_count;
     }
+    if (next_row != ihdr.height)
+        segments.clear();
+
     // If everything is correct, return true
-    std::cout << "Parse iCCP chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse iDOT chunk successfully!");
     return true;
 }
 
-bool parse_itxt_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_itxt_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text, scratch_arena_t &scratch)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "iTXt" chunk type)
-    const char chunk_type[4] = {'i', 'T', 'X', 't'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "iTXt"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
+
+    // Keyword, null separator, compression flag, compression method, language tag, null separator,
+    // translated keyword, null separator, text
+    text_t entry;
+    size_t offset;
+    if (!read_keyword(buffer.first(chunk_length), entry.keyword, offset) || offset + 2 > chunk_length)
     {
-        std::cerr << "Error: Parse iTXt chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Invalid iTXt chunk header!" << std::endl;
+        return false;
     }
+    const bool compressed = buffer[offset] != 0;
+    const uint8_t method = buffer[offset + 1];
+    offset += 2;
+    for (int field = 0; field < 2; field++) // Skip the language tag and the translated keyword
+    {
+        const void *end = offset < chunk_length ? std::memchr(buffer.data() + offset, 0, chunk_length - offset) : nullptr;
+        if (end == nullptr)
+        {
+            std::cerr << "Error: Invalid iTXt chunk header!" << std::endl;
+            return false;
+        }
+        offset = static_cast<size_t>(static_cast<const uint8_t *>(end) - buffer.data()) + 1;
+    }
+    if (!compressed)
+        entry.text.assign(reinterpret_cast<const char *>(buffer.data() + offset), chunk_length - offset);
+    else if (method != 0 || !inflate_text(buffer.data() + offset, chunk_length - offset, entry.text, scratch))
+    {
+        std::cerr << "Error: Parse iTXt chunk - Invalid compressed text!" << std::endl;
+        return false;
+    }
+    text.push_back(std::move(entry));
+
     // If everything is correct, return true
-    std::cout << "Parse iTXt chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse iTXt chunk successfully!");
     return true;
 }
 
-bool parse_phys_chunk(std::ifstream &stream, uint32_t chunk_length, pHYs_t &phys)
+bool parse_phys_chunk(std::span<const uint8_t> buffer, pHYs_t &phys)
 {
-    // pHYs chunk must be 9 bytes long (this is specified by the PNG standard)
-    assert(chunk_length == 9);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // pHYs chunk must be 9 bytes long (this is specified by the PNG standard)
+    if (chunk_length != 9)
+    {
+        std::cerr << "Error: Invalid pHYs chunk length!" << std::endl;
+        return false;
+    }
 
     // Extract pixels per unit (X axis) from the first 4 bytes
     phys.pixels_per_unit_x = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
@@ -504,221 +561,149 @@ bool parse_phys_chunk(std::ifstream &stream, uint32_t chunk_length, pHYs_t &phys
     // Extract unit specifier from the 9th byte
     phys.unit_specifier = buffer[8];
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "pHYs" chunk type)
-    const char chunk_type[4] = {'p', 'H', 'Y', 's'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "pHYs"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse pHYs chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse pHYs chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse pHYs chunk successfully!");
     return true;
 }
 
-bool parse_sbit_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_sbit_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "sBIT" chunk type)
-    const char chunk_type[4] = {'s', 'B', 'I', 'T'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "sBIT"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse sBIT chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse sBIT chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse sBIT chunk successfully!");
     return true;
 }
 
-bool parse_splt_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_splt_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Calculate the CRC of the chunk data (including the "sPLT" chunk type)
-    const char chunk_type[4] = {'s', 'P', 'L', 'T'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "sPLT"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse sPLT chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse sPLT chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse sPLT chunk successfully!");
     return true;
 }
 
-bool parse_srgb_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_srgb_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "sRGB" chunk type)
-    const char chunk_type[4] = {'s', 'R', 'G', 'B'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "sRGB"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse sRGB chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse sRGB chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse sRGB chunk successfully!");
     return true;
 }
 
-bool parse_ster_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_ster_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Calculate the CRC of the chunk data (including the "sTER" chunk type)
-    const char chunk_type[4] = {'s', 'T', 'E', 'R'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "sTER"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse sTER chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse sTER chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse sTER chunk successfully!");
     return true;
 }
 
-bool parse_text_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_text_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "tEXt" chunk type)
-    const char chunk_type[4] = {'t', 'E', 'X', 't'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "tEXt"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // Keyword, null separator, text
+    text_t entry;
+    size_t offset;
+    if (!read_keyword(buffer.first(chunk_length), entry.keyword, offset))
     {
-        std::cerr << "Error: Parse tEXt chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Invalid tEXt chunk keyword!" << std::endl;
+        return false;
     }
+    entry.text.assign(reinterpret_cast<const char *>(buffer.data() + offset), chunk_length - offset);
+    text.push_back(std::move(entry));
+
     // If everything is correct, return true
-    std::cout << "Parse tEXt chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse tEXt chunk successfully!");
     return true;
 }
 
-bool parse_time_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_time_chunk(std::span<const uint8_t> buffer)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "tIME" chunk type)
-    const char chunk_type[4] = {'t', 'I', 'M', 'E'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "tIME"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
+    // The chunk data is not interpreted yet, its CRC has been checked by the decoder
+    (void)buffer;
 
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
-    {
-        std::cerr << "Error: Parse tIME chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
-    }
     // If everything is correct, return true
-    std::cout << "Parse tIME chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse tIME chunk successfully!");
     return true;
 }
 
-bool parse_trns_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_trns_chunk(std::span<const uint8_t> buffer, uint8_t color_type, tRNS_t &trns)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
-
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Calculate the CRC of the chunk data (including the "tRNS" chunk type)
-    const char chunk_type[4] = {'t', 'R', 'N', 'S'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "tRNS"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // The layout of the transparency data depends on the color type
+    switch (color_type)
     {
-        std::cerr << "Error: Parse tRNS chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+    case 0: // Grayscale: a single transparent gray level
+        if (chunk_length != 2)
+        {
+            std::cerr << "Error: Invalid tRNS chunk length!" << std::endl;
+            return false;
+        }
+        trns.gray = static_cast<uint16_t>(buffer[0] << 8 | buffer[1]);
+        break;
+    case 2: // Truecolor: a single transparent RGB color
+        if (chunk_length != 6)
+        {
+            std::cerr << "Error: Invalid tRNS chunk length!" << std::endl;
+            return false;
+        }
+        trns.red = static_cast<uint16_t>(buffer[0] << 8 | buffer[1]);
+        trns.green = static_cast<uint16_t>(buffer[2] << 8 | buffer[3]);
+        trns.blue = static_cast<uint16_t>(buffer[4] << 8 | buffer[5]);
+        break;
+    case 3: // Indexed-color: one alpha value per palette entry, missing entries are opaque
+        if (chunk_length > 256)
+        {
+            std::cerr << "Error: Invalid tRNS chunk length!" << std::endl;
+            return false;
+        }
+        std::memcpy(trns.palette_alpha, buffer.data(), chunk_length);
+        trns.palette_alpha_count = static_cast<uint16_t>(chunk_length);
+        break;
+    default: // Images with an alpha channel cannot have a tRNS chunk
+        std::cerr << "Error: tRNS chunk is not allowed for color type " << static_cast<int>(color_type) << "!" << std::endl;
+        return false;
     }
+    trns.present = true;
+
     // If everything is correct, return true
-    std::cout << "Parse tRNS chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse tRNS chunk successfully!");
     return true;
 }
 
-bool parse_ztxt_chunk(std::ifstream &stream, uint32_t chunk_length)
+bool parse_ztxt_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text, scratch_arena_t &scratch)
 {
-    // Read the palette data (chunk_length bytes)
-    std::vector<uint8_t> buffer(chunk_length + 4); // +4 for the CRC
-    stream.read(reinterpret_cast<char *>(buffer.data()), chunk_length + 4);
+    // The chunk data is followed by its 4-byte CRC
+    const uint32_t chunk_length = static_cast<uint32_t>(buffer.size() - 4);
 
-    // Extract the CRC value from the last 4 bytes of the buffer
-    uint32_t crc_value = (buffer[chunk_length] << 24) | (buffer[chunk_length + 1] << 16) | (buffer[chunk_length + 2] << 8) | (buffer[chunk_length + 3]);
-
-    // Calculate the CRC of the chunk data (including the "zTXt" chunk type)
-    const char chunk_type[4] = {'z', 'T', 'X', 't'};
-    uint32_t calculated_crc = crc32(0L, (uint8_t *)chunk_type, 4);       // Start with the chunk type "zTXt"
-    calculated_crc = crc32(calculated_crc, buffer.data(), chunk_length); // Include chunk data
-
-    // Check if the calculated CRC matches the one read from the file
-    if (calculated_crc != crc_value)
+    // Keyword, null separator, compression method (0 = zlib), compressed text
+    text_t entry;
+    size_t offset;
+    if (!read_keyword(buffer.first(chunk_length), entry.keyword, offset) || offset >= chunk_length || buffer[offset] != 0)
     {
-        std::cerr << "Error: Parse zTXt chunk - CRC mismatch!" << std::endl;
-        return false; // Return false if there's a CRC mismatch
+        std::cerr << "Error: Invalid zTXt chunk header!" << std::endl;
+        return false;
     }
+    if (!inflate_text(buffer.data() + offset + 1, chunk_length - offset - 1, entry.text, scratch))
+    {
+        std::cerr << "Error: Parse zTXt chunk - Invalid compressed text!" << std::endl;
+        return false;
+    }
+    text.push_back(std::move(entry));
+
     // If everything is correct, return true
-    std::cout << "Parse zTXt chunk successfully!" << std::endl;
+    EPL_LOG(LOG_DEBUG, "Parse zTXt chunk successfully!");
     return true;
 }
@@ -3,80 +3,128 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <span>
 #include <string.h>
 #include <vector>
 
+#include "inflate_backend.h"
 #include "png_properties.h"
 
+// Persistent inflate state used to decompress IDAT chunks as soon as they are read. The backend stream outlives an
+// image: beginning the next one resets it.
+typedef struct _idat_inflater
+{
+    const inflate_backend_t *backend = nullptr; // A streaming backend
+    void *stream = nullptr;                     // Its stream state
+    byte_buffer_t output;                       // Decompressed (still filtered) scanlines, sized exactly from the IHDR geometry
+    size_t output_used = 0;
+    bool initialized = false;
+    bool finished = false; // Set once the end of the zlib stream (or of a truncated output) has been reached
+    bool truncated = false; // Only the start of the stream is wanted: inflating stops once the output is full
+
+    ~_idat_inflater();
+} idat_inflater_t;
+
 bool parse_png_header(const char *filename, IHDR_t *props);
 
+// Every chunk parser receives a view of the chunk data followed by its 4-byte CRC,
+// pointing either into a memory-mapped file or into the read buffer of a stream source.
+// The CRC is checked by the decoder before the parser runs, as its crc_policy asks (see chunk_crc.h).
+
 // Parse the IHDR chunk
-bool parse_ihdr_chunk(std::ifstream &stream, uint32_t chunk_length, IHDR_t &ihdr);
+bool parse_ihdr_chunk(std::span<const uint8_t> buffer, IHDR_t &ihdr);
 
 // Parse the PLTE chunk
-bool parse_plte_chunk(std::ifstream &stream, uint32_t chunk_length, std::vector<RGB_t> &palette);
+bool parse_plte_chunk(std::span<const uint8_t> buffer, std::vector<RGB_t> &palette);
 
 // Parse the IDAT chunk
-bool parse_idat_chunk(std::ifstream &stream, uint32_t chunk_length, std::vector<uint8_t> &compressed_data);
+bool parse_idat_chunk(std::span<const uint8_t> buffer, std::vector<uint8_t> &compressed_data);
+
+// Parse the IDAT chunk and feed its data straight into the inflater, without keeping the compressed bytes
+bool parse_idat_chunk(std::span<const uint8_t> buffer, idat_inflater_t &inflater);
+
+typedef struct _fused_inflater fused_inflater_t;
+typedef struct _idot_segment idot_segment_t;
+
+// Parse the IDAT chunk, inflating it and unfiltering the scanlines it completes (see fused_inflater.h)
+bool parse_idat_chunk(std::span<const uint8_t> buffer, fused_inflater_t &inflater);
 
-// Function to decompress the concatenated IDAT data
-std::vector<uint8_t> decompress_idat_data(const std::vector<uint8_t> &compressed_data);
+// Function to decompress the concatenated IDAT data into exactly `expected_size` bytes (see inflated_image_size).
+// With `truncated`, only the first `expected_size` bytes of a longer stream are inflated (see inflated_rows_size).
+// The default backend is used without one; zlib takes over truncated streams the backend cannot stop early.
+bool decompress_idat_data(const std::vector<uint8_t> &compressed_data, size_t expected_size, byte_buffer_t &decompressed_data, bool truncated = false,
+                          const inflate_backend_t *backend = nullptr);
+
+// Initialize the inflater before the first IDAT chunk, allocating the whole `expected_size` output once.
+// With `truncated`, the stream may be longer: the inflater is finished as soon as `expected_size` bytes are out.
+// The backend (the default one without it) must be able to stream.
+bool begin_idat_inflate(idat_inflater_t &inflater, size_t expected_size, bool truncated = false, const inflate_backend_t *backend = nullptr);
+
+// Inflate the next piece of the zlib stream; fails if the stream inflates to more than the expected size
+bool feed_idat_data(idat_inflater_t &inflater, const uint8_t *data, size_t size);
+
+// Check that the whole zlib stream was inflated and hand the decompressed data over
+bool finish_idat_inflate(idat_inflater_t &inflater, byte_buffer_t &decompressed_data);
 
 // Parse the IEND chunk
-bool parse_iend_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_iend_chunk(std::span<const uint8_t> buffer);
 
-// Parse the bKGD chunk
-bool parse_bkgd_chunk(std::ifstream &stream, uint32_t chunk_length, bKGD_t &bkgd_color);
+// Parse the bKGD chunk, samples of `bit_depth` bits are stored as 8-bit colors
+bool parse_bkgd_chunk(std::span<const uint8_t> buffer, uint8_t bit_depth, bKGD_t &bkgd_color);
 
 // Parse the cHRM chunk
-bool parse_chrm_chunk(std::ifstream &stream, uint32_t chunk_length, cHRM_t &chrm);
+bool parse_chrm_chunk(std::span<const uint8_t> buffer, cHRM_t &chrm);
 
 // Parse the cICP chunk
-bool parse_cicp_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_cicp_chunk(std::span<const uint8_t> buffer);
 
 // Parse the dSIG chunk
-bool parse_dsig_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_dsig_chunk(std::span<const uint8_t> buffer);
 
 // Parse the eXIf chunk
-bool parse_exif_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_exif_chunk(std::span<const uint8_t> buffer);
 
 // Parse the gAMA chunk
-bool parse_gama_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_gama_chunk(std::span<const uint8_t> buffer);
 
 // Parse the hIST chunk
-bool parse_hist_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_hist_chunk(std::span<const uint8_t> buffer);
 
 // Parse the iCCP chunk
-bool parse_iccp_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_iccp_chunk(std::span<const uint8_t> buffer);
+
+// Parse the iDOT chunk, which splits the image data into bands of rows (see parallel_inflate.h). `chunk_offset` is its
+// file offset, which the segment offsets are relative to. Segments that do not describe the image are left out.
+bool parse_idot_chunk(std::span<const uint8_t> buffer, uint64_t chunk_offset, const IHDR_t &ihdr, std::vector<idot_segment_t> &segments);
 
 // Parse the iTXt chunk
-bool parse_itxt_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_itxt_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text, scratch_arena_t &scratch);
 
 // Parse the pHYs chunk
-bool parse_phys_chunk(std::ifstream &stream, uint32_t chunk_length, pHYs_t &phys);
+bool parse_phys_chunk(std::span<const uint8_t> buffer, pHYs_t &phys);
 
 // Parse the sBIT chunk
-bool parse_sbit_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_sbit_chunk(std::span<const uint8_t> buffer);
 
 // Parse the sPLT chunk
-bool parse_splt_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_splt_chunk(std::span<const uint8_t> buffer);
 
 // Parse the sRGB chunk
-bool parse_srgb_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_srgb_chunk(std::span<const uint8_t> buffer);
 
 // Parse the sTER chunk
-bool parse_ster_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_ster_chunk(std::span<const uint8_t> buffer);
 
 // Parse the tEXt chunk
-bool parse_text_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_text_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text);
 
 // Parse the tIME chunk
-bool parse_time_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_time_chunk(std::span<const uint8_t> buffer);
 
 // Parse the tRNS chunk
-bool parse_trns_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_trns_chunk(std::span<const uint8_t> buffer, uint8_t color_type, tRNS_t &trns);
 
 // Parse the zTXt chunk
-bool parse_ztxt_chunk(std::ifstream &stream, uint32_t chunk_length);
+bool parse_ztxt_chunk(std::span<const uint8_t> buffer, std::vector<text_t> &text, scratch_arena_t &scratch);
 
 #endif // __PARSING_CHUNKS__
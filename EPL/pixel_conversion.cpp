@@ -0,0 +1,466 @@
+#include "pixel_conversion.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
+// Packed indices are unpacked to bytes in blocks of this many pixels (a multiple of 8, so blocks start on a byte)
+static const uint32_t INDEX_BLOCK = 256;
+
+// Unpack 1, 2 or 4-bit samples to one byte per sample: one table entry holds every sample of a source byte
+template <uint32_t BITS>
+static void unpack_samples_table(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    const uint32_t per_byte = 8 / BITS;
+    uint32_t i = 0;
+    for (; i + per_byte <= count; i += per_byte)
+        std::memcpy(dst + i, converter.unpack_table[*src++], per_byte);
+    if (i < count)
+        std::memcpy(dst + i, converter.unpack_table[*src], count - i);
+}
+
+#if defined(EPL_HAVE_AVX2)
+// 1-bit samples, 128 at a time: pshufb spreads every source byte over 8 lanes, each lane then tests its own bit
+EPL_TARGET_SSSE3 static uint32_t unpack_bits_ssse3(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    const __m128i bit_masks = _mm_set1_epi64x(0x0102040810204080); // Most significant bit first
+    const __m128i set_value = _mm_set1_epi8(static_cast<char>(converter.unpack_table[0x80][0]));
+    const __m128i first_pair = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i next_pair = _mm_set1_epi8(2);
+
+    uint32_t i = 0;
+    for (; i + 128 <= count; i += 128, src += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        __m128i pair = first_pair;
+        for (int k = 0; k < 8; k++, pair = _mm_add_epi8(pair, next_pair))
+        {
+            const __m128i bits = _mm_and_si128(_mm_shuffle_epi8(x, pair), bit_masks);
+            const __m128i set = _mm_cmpeq_epi8(bits, bit_masks);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 16 * k), _mm_and_si128(set, set_value));
+        }
+    }
+    return i;
+}
+#endif
+
+// Unpack a row of 1, 2 or 4-bit samples (palette indices or grayscale levels) to one byte per sample
+static void unpack_samples(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    switch (converter.bit_depth)
+    {
+    case 1:
+    {
+        uint32_t done = 0;
+#if defined(EPL_HAVE_AVX2)
+        if (cpu_has_ssse3())
+            done = unpack_bits_ssse3(converter, src, count, dst);
+#endif
+        return unpack_samples_table<1>(converter, src + done / 8, count - done, dst + done);
+    }
+    case 2:
+        return unpack_samples_table<2>(converter, src, count, dst);
+    case 4:
+        return unpack_samples_table<4>(converter, src, count, dst);
+    }
+}
+
+// Fill the unpacking table, optionally scaling the samples to the full 0-255 range
+static void build_unpack_table(row_converter_t &converter, bool scale)
+{
+    if (converter.unpack_bits == converter.bit_depth && converter.unpack_scaled == scale)
+        return;
+    converter.unpack_bits = converter.bit_depth;
+    converter.unpack_scaled = scale;
+
+    const uint32_t bits = converter.bit_depth;
+    const uint32_t mask = (1u << bits) - 1;
+    const uint32_t factor = scale ? 255 / mask : 1;
+    for (uint32_t byte = 0; byte < 256; byte++)
+        for (uint32_t k = 0; k < 8 / bits; k++)
+            converter.unpack_table[byte][k] = static_cast<uint8_t>(((byte >> (8 - bits * (k + 1))) & mask) * factor);
+}
+
+template <size_t CHANNELS>
+static void lookup_palette_scalar(const row_converter_t &converter, const uint8_t *indices, uint32_t count, uint8_t *dst)
+{
+    for (uint32_t i = 0; i < count; i++, dst += CHANNELS)
+        std::memcpy(dst, converter.palette[indices[i]], CHANNELS);
+}
+
+#if defined(EPL_HAVE_AVX2)
+// Store the low 12 bytes of a vector (4 RGB pixels) without touching the bytes after them
+static inline void store_rgb12(uint8_t *dst, __m128i pixels)
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), pixels);
+    const int last = _mm_cvtsi128_si32(_mm_srli_si128(pixels, 8));
+    std::memcpy(dst + 8, &last, 4);
+}
+
+// Palettes indexed by at most 4 bits fit in one register per channel: every lookup is a single pshufb
+template <size_t CHANNELS>
+EPL_TARGET_SSSE3 static void lookup_palette16_ssse3(const row_converter_t &converter, const uint8_t *indices, uint32_t count, uint8_t *dst)
+{
+    const __m128i red = _mm_load_si128(reinterpret_cast<const __m128i *>(converter.palette_planes[0]));
+    const __m128i green = _mm_load_si128(reinterpret_cast<const __m128i *>(converter.palette_planes[1]));
+    const __m128i blue = _mm_load_si128(reinterpret_cast<const __m128i *>(converter.palette_planes[2]));
+    const __m128i alpha = _mm_load_si128(reinterpret_cast<const __m128i *>(converter.palette_planes[3]));
+    const __m128i rgba_to_rgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16, dst += 16 * CHANNELS)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i));
+        const __m128i r = _mm_shuffle_epi8(red, x);
+        const __m128i g = _mm_shuffle_epi8(green, x);
+        const __m128i b = _mm_shuffle_epi8(blue, x);
+        const __m128i a = _mm_shuffle_epi8(alpha, x);
+
+        // Interleave the planes into RGBA pixels
+        const __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+        const __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+        const __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+        const __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+        const __m128i p[4] = {_mm_unpacklo_epi16(rg_lo, ba_lo), _mm_unpackhi_epi16(rg_lo, ba_lo), _mm_unpacklo_epi16(rg_hi, ba_hi), _mm_unpackhi_epi16(rg_hi, ba_hi)};
+        for (int k = 0; k < 4; k++)
+        {
+            if (CHANNELS == 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16 * k), p[k]);
+            else
+                store_rgb12(dst + 12 * k, _mm_shuffle_epi8(p[k], rgba_to_rgb));
+        }
+    }
+    lookup_palette_scalar<CHANNELS>(converter, indices + i, count - i, dst);
+}
+
+// 8-bit indices: gather 8 RGBA entries of the table at once
+template <size_t CHANNELS>
+EPL_TARGET_AVX2 static void lookup_palette_avx2(const row_converter_t &converter, const uint8_t *indices, uint32_t count, uint8_t *dst)
+{
+    const int *table = reinterpret_cast<const int *>(converter.palette);
+    const __m256i rgba_to_rgb = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8, dst += 8 * CHANNELS)
+    {
+        const __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(indices + i)));
+        const __m256i pixels = _mm256_i32gather_epi32(table, x, 4);
+        if (CHANNELS == 4)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), pixels);
+        else
+        {
+            const __m256i rgb = _mm256_shuffle_epi8(pixels, rgba_to_rgb);
+            store_rgb12(dst, _mm256_castsi256_si128(rgb));
+            store_rgb12(dst + 12, _mm256_extracti128_si256(rgb, 1));
+        }
+    }
+    lookup_palette_scalar<CHANNELS>(converter, indices + i, count - i, dst);
+}
+
+// Byte-swap 16 samples at a time, returns the number of samples done
+EPL_TARGET_AVX2 static size_t swap_samples_16_avx2(const uint8_t *src, size_t samples, uint8_t *dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * i), _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8)));
+    }
+    return i;
+}
+
+// Reduce 32 samples at a time to 8 bits, returns the number of samples done
+EPL_TARGET_AVX2 static size_t reduce_samples_16_avx2(const uint8_t *src, size_t samples, uint8_t *dst)
+{
+    const __m256i scale = _mm256_set1_epi16(static_cast<short>(0xFF01));
+    const __m256i half = _mm256_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 32 <= samples; i += 32)
+    {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i + 32));
+        lo = _mm256_or_si256(_mm256_slli_epi16(lo, 8), _mm256_srli_epi16(lo, 8));
+        hi = _mm256_or_si256(_mm256_slli_epi16(hi, 8), _mm256_srli_epi16(hi, 8));
+        lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(lo, scale), half), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(hi, scale), half), 8);
+        // packus works per 128-bit lane, put the 64-bit quarters back in order
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+    }
+    return i;
+}
+#endif
+
+// Look up one byte-sized index per pixel; `small_indices` tells that every index is below 16
+template <size_t CHANNELS>
+static void lookup_palette(const row_converter_t &converter, const uint8_t *indices, uint32_t count, uint8_t *dst, bool small_indices)
+{
+#if defined(EPL_HAVE_AVX2)
+    if (small_indices && cpu_has_ssse3())
+        return lookup_palette16_ssse3<CHANNELS>(converter, indices, count, dst);
+    if (cpu_has_avx2())
+        return lookup_palette_avx2<CHANNELS>(converter, indices, count, dst);
+#endif
+    (void)small_indices;
+    lookup_palette_scalar<CHANNELS>(converter, indices, count, dst);
+}
+
+template <size_t CHANNELS>
+static void expand_palette(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    if (converter.bit_depth == 8)
+        return lookup_palette<CHANNELS>(converter, src, count, dst, false);
+
+    // Packed indices: unpack a block to bytes, then look it up while it is still in L1
+    const uint32_t bits = converter.bit_depth;
+    uint8_t indices[INDEX_BLOCK];
+    while (count > 0)
+    {
+        const uint32_t n = std::min(count, INDEX_BLOCK);
+        unpack_samples(converter, src, n, indices);
+        lookup_palette<CHANNELS>(converter, indices, n, dst, true);
+        src += n * bits / 8;
+        dst += n * CHANNELS;
+        count -= n;
+    }
+}
+
+// Byte-swap big-endian 16-bit samples (only used on little-endian hosts)
+static void swap_samples_16(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    const size_t samples = static_cast<size_t>(count) * converter.layout.channels;
+    size_t i = 0;
+#if defined(EPL_HAVE_AVX2)
+    if (cpu_has_avx2())
+        i = swap_samples_16_avx2(src, samples, dst);
+#endif
+#if defined(EPL_HAVE_SSE2)
+    for (; i + 8 <= samples; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+        const uint16_t value = static_cast<uint16_t>(src[2 * i] << 8 | src[2 * i + 1]);
+        std::memcpy(dst + 2 * i, &value, 2);
+    }
+}
+
+// Reduce big-endian 16-bit samples to 8 bits: round(v * 255 / 65535) == ((v * 0xFF01 >> 16) + 128) >> 8 for every v
+static void reduce_samples_16(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    const size_t samples = static_cast<size_t>(count) * converter.layout.channels;
+    size_t i = 0;
+#if defined(EPL_HAVE_AVX2)
+    if (cpu_has_avx2())
+        i = reduce_samples_16_avx2(src, samples, dst);
+#endif
+#if defined(EPL_HAVE_SSE2)
+    const __m128i scale = _mm_set1_epi16(static_cast<short>(0xFF01));
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 16 <= samples; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16));
+        lo = _mm_or_si128(_mm_slli_epi16(lo, 8), _mm_srli_epi16(lo, 8));
+        hi = _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(hi, 8));
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(lo, scale), half), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(hi, scale), half), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+        const uint32_t value = static_cast<uint32_t>(src[2 * i] << 8 | src[2 * i + 1]);
+        dst[i] = static_cast<uint8_t>(((value * 0xFF01 >> 16) + 128) >> 8);
+    }
+}
+
+#if defined(EPL_HAVE_AVX2)
+// Swap red and blue with one pshufb per vector of whole pixels, returns the number of bytes done
+template <size_t CHANNELS, size_t SAMPLE_BYTES>
+EPL_TARGET_SSSE3 static size_t swap_red_blue_ssse3(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    // The bytes after the last whole pixel of a vector are copied unchanged and rewritten by the next iteration,
+    // which keeps the kernel correct when it runs in place
+    const size_t pixel = CHANNELS * SAMPLE_BYTES;
+    const size_t step = 16 / pixel * pixel;
+    alignas(16) uint8_t order[16];
+    for (size_t b = 0; b < 16; b++)
+    {
+        const size_t channel = b % pixel / SAMPLE_BYTES;
+        const size_t from = channel == 0 ? 2 : channel == 2 ? 0 : channel;
+        order[b] = static_cast<uint8_t>(b >= step ? b : b / pixel * pixel + from * SAMPLE_BYTES + b % SAMPLE_BYTES);
+    }
+    const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(order));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += step)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), mask));
+    return i;
+}
+#endif
+
+// RGB(A) -> BGR(A), `src` may be `dst`
+template <size_t CHANNELS, size_t SAMPLE_BYTES>
+static void swap_red_blue(const row_converter_t &, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    const size_t pixel = CHANNELS * SAMPLE_BYTES;
+    const size_t size = static_cast<size_t>(count) * pixel;
+    size_t i = 0;
+#if defined(EPL_HAVE_AVX2)
+    if (cpu_has_ssse3())
+        i = swap_red_blue_ssse3<CHANNELS, SAMPLE_BYTES>(src, size, dst);
+#endif
+    for (; i < size; i += pixel)
+    {
+        uint8_t rgba[pixel];
+        std::memcpy(rgba, src + i, pixel);
+        std::memcpy(dst + i, rgba + 2 * SAMPLE_BYTES, SAMPLE_BYTES);
+        std::memcpy(dst + i + SAMPLE_BYTES, rgba + SAMPLE_BYTES, SAMPLE_BYTES);
+        std::memcpy(dst + i + 2 * SAMPLE_BYTES, rgba, SAMPLE_BYTES);
+        if (CHANNELS == 4)
+            std::memcpy(dst + i + 3 * SAMPLE_BYTES, rgba + 3 * SAMPLE_BYTES, SAMPLE_BYTES);
+    }
+}
+
+// Gray + alpha -> RGBA (gray in all three color channels, so the order does not matter), `src` may be `dst`: the
+// pixels are expanded from the last one, whose output starts at or after its own input
+template <size_t SAMPLE_BYTES>
+static void expand_gray_alpha(const row_converter_t &, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    for (size_t i = count; i-- > 0;)
+    {
+        uint8_t gray_alpha[2 * SAMPLE_BYTES];
+        std::memcpy(gray_alpha, src + i * 2 * SAMPLE_BYTES, 2 * SAMPLE_BYTES);
+        uint8_t *pixel = dst + i * 4 * SAMPLE_BYTES;
+        std::memcpy(pixel, gray_alpha, SAMPLE_BYTES);
+        std::memcpy(pixel + SAMPLE_BYTES, gray_alpha, SAMPLE_BYTES);
+        std::memcpy(pixel + 2 * SAMPLE_BYTES, gray_alpha, SAMPLE_BYTES);
+        std::memcpy(pixel + 3 * SAMPLE_BYTES, gray_alpha + SAMPLE_BYTES, SAMPLE_BYTES);
+    }
+}
+
+// Sample conversion followed by the channel swap, in place on the (cache-hot) output row
+static void convert_then_swap(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst)
+{
+    converter.convert_samples(converter, src, count, dst);
+    converter.swap_channels(converter, dst, count, dst);
+}
+
+// Merge PLTE and tRNS into the RGBA lookup tables
+static void build_palette_table(row_converter_t &converter, const std::vector<RGB_t> &palette, const tRNS_t &trns, bool bgr_order)
+{
+    // Images of a batch often share their palette, comparing it is cheaper than rebuilding the tables
+    static_assert(sizeof(RGB_t) == 3, "PLTE entries are compared as bytes");
+    const size_t palette_bytes = palette.size() * sizeof(RGB_t);
+    if (converter.palette_built && converter.palette_bgr == bgr_order && converter.palette_size == palette.size() && converter.palette_alpha_count == trns.palette_alpha_count &&
+        std::memcmp(converter.palette_source, palette.data(), palette_bytes) == 0 && std::memcmp(converter.palette_alpha, trns.palette_alpha, trns.palette_alpha_count) == 0)
+        return;
+    converter.palette_built = true;
+    converter.palette_bgr = bgr_order;
+    converter.palette_size = static_cast<uint16_t>(palette.size());
+    converter.palette_alpha_count = trns.palette_alpha_count;
+    std::memcpy(converter.palette_source, palette.data(), palette_bytes);
+    std::memcpy(converter.palette_alpha, trns.palette_alpha, trns.palette_alpha_count);
+
+    // For BGR output the channels are swapped once here instead of in every pixel
+    const size_t red = bgr_order ? 2 : 0;
+    const size_t blue = bgr_order ? 0 : 2;
+    for (size_t i = 0; i < 256; i++)
+    {
+        uint8_t *entry = converter.palette[i];
+        entry[red] = i < palette.size() ? palette[i].red : 0;
+        entry[1] = i < palette.size() ? palette[i].green : 0;
+        entry[blue] = i < palette.size() ? palette[i].blue : 0;
+        entry[3] = i < trns.palette_alpha_count ? trns.palette_alpha[i] : 255;
+    }
+    for (size_t i = 0; i < 16; i++)
+        for (size_t c = 0; c < 4; c++)
+            converter.palette_planes[c][i] = converter.palette[i][c];
+}
+
+bool setup_row_converter(row_converter_t &converter, const png_properties_t &properties, const decode_options_t &options)
+{
+    const IHDR_t &ihdr = properties.ihdr;
+    converter.convert = nullptr;
+    converter.convert_samples = nullptr;
+    converter.swap_channels = nullptr;
+    converter.bit_depth = ihdr.bit_depth;
+    converter.layout.width = ihdr.width;
+    converter.layout.height = ihdr.height;
+    converter.layout.channels = ihdr.channels;
+    converter.layout.bit_depth = ihdr.bit_depth;
+
+    if (ihdr.color_type == 3 && options.expand_palette)
+    {
+        if (properties.palette.empty())
+        {
+            std::cerr << "Error: Indexed-color image without a PLTE chunk!" << std::endl;
+            return false;
+        }
+        build_palette_table(converter, properties.palette, properties.trns, options.bgr_order);
+        if (ihdr.bit_depth < 8)
+            build_unpack_table(converter, false);
+
+        const bool has_alpha = properties.trns.palette_alpha_count > 0;
+        converter.layout.channels = has_alpha ? 4 : 3;
+        converter.layout.bit_depth = 8;
+        converter.convert = has_alpha ? expand_palette<4> : expand_palette<3>;
+    }
+    else if (ihdr.bit_depth < 8 && options.unpack_sub_byte)
+    {
+        // Only grayscale levels are scaled, palette indices keep their value
+        build_unpack_table(converter, ihdr.color_type == 0 && options.scale_gray);
+        converter.layout.bit_depth = 8;
+        converter.convert = unpack_samples;
+    }
+    else if (ihdr.bit_depth == 16 && options.samples_16bit == SAMPLE16_TO_8BIT)
+    {
+        converter.layout.bit_depth = 8;
+        converter.convert = reduce_samples_16;
+    }
+    else if (ihdr.bit_depth == 16 && options.samples_16bit == SAMPLE16_NATIVE && std::endian::native == std::endian::little)
+    {
+        converter.convert = swap_samples_16;
+    }
+
+    // Truecolor rows get their red and blue samples swapped after any sample conversion, gray + alpha rows are expanded
+    convert_row_fn swap = nullptr;
+    if (options.bgr_order && (ihdr.color_type == 2 || ihdr.color_type == 6))
+    {
+        const bool alpha = ihdr.color_type == 6;
+        if (converter.layout.bit_depth == 16)
+            swap = alpha ? swap_red_blue<4, 2> : swap_red_blue<3, 2>;
+        else
+            swap = alpha ? swap_red_blue<4, 1> : swap_red_blue<3, 1>;
+    }
+    else if (options.expand_gray_alpha && ihdr.color_type == 4)
+    {
+        converter.layout.channels = 4;
+        swap = converter.layout.bit_depth == 16 ? expand_gray_alpha<2> : expand_gray_alpha<1>;
+    }
+
+    if (swap != nullptr)
+    {
+        if (converter.convert == nullptr)
+            converter.convert = swap;
+        else
+        {
+            converter.convert_samples = converter.convert;
+            converter.swap_channels = swap;
+            converter.convert = convert_then_swap;
+        }
+    }
+
+    converter.layout.row_stride = (static_cast<size_t>(ihdr.width) * converter.layout.channels * converter.layout.bit_depth + 7) / 8;
+    return true;
+}
+
+size_t output_pixel_size(const row_converter_t &converter)
+{
+    const size_t bits = static_cast<size_t>(converter.layout.channels) * converter.layout.bit_depth;
+    return bits % 8 == 0 ? bits / 8 : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __PIXEL_CONVERSION_H__
+#define __PIXEL_CONVERSION_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "decode_options.h"
+#include "png_properties.h"
+
+typedef struct _row_converter row_converter_t;
+
+// Convert `count` unfiltered pixels (PNG sample layout) starting at `src` into the output layout at `dst`
+typedef void (*convert_row_fn)(const row_converter_t &converter, const uint8_t *src, uint32_t count, uint8_t *dst);
+
+// Conversion from the PNG sample layout of a scanline to the requested output layout.
+// It is set up once per image and applied to every unfiltered row, so pixels are converted while they are still in cache.
+typedef struct _row_converter
+{
+    convert_row_fn convert;         // nullptr when the output keeps the PNG sample layout
+    convert_row_fn convert_samples; // With a channel swap (or expansion) after a sample conversion: the two stages convert runs
+    convert_row_fn swap_channels;
+    uint8_t bit_depth;              // Bit depth of the source samples
+    pixel_layout_t layout;          // Output layout (row_stride is for the full image width)
+
+    // PLTE and tRNS merged into a single RGBA table, entries missing from the palette are opaque black
+    alignas(32) uint8_t palette[256][4];
+    // The first 16 entries again, one plane per channel, for pshufb lookups of 1, 2 and 4-bit indices
+    alignas(16) uint8_t palette_planes[4][16];
+    // Samples of every possible byte of 1, 2 or 4-bit pixels, already unpacked (and scaled if requested)
+    alignas(8) uint8_t unpack_table[256][8];
+
+    // What the tables hold, so a converter reused for the next image (see decoder_context.h) skips rebuilding them
+    bool palette_built = false;
+    bool palette_bgr;
+    uint16_t palette_size;
+    uint16_t palette_alpha_count;
+    uint8_t palette_source[256][3]; // PLTE entries
+    uint8_t palette_alpha[256];     // tRNS entries
+    uint8_t unpack_bits = 0;        // 0 until the unpack table is built
+    bool unpack_scaled;
+} row_converter_t;
+
+// Choose the conversion of an image from its header chunks and the decode options
+bool setup_row_converter(row_converter_t &converter, const png_properties_t &properties, const decode_options_t &options);
+
+// Bytes taken by one output pixel, 0 for packed sub-byte pixels
+size_t output_pixel_size(const row_converter_t &converter);
+
+#endif // __PIXEL_CONVERSION_H__
@@ -0,0 +1,604 @@
+#include "png_decoder.h"
+#include "chunk_crc.h"
+#include "chunk_handlers.h"
+#include "chunk_types.h"
+#include "crc_checker.h"
+#include "decode_log.h"
+#include "decoder_context.h"
+#include "fused_inflater.h"
+#include "image_scaler.h"
+#include "parallel_inflate.h"
+#include "parsing_chunks.h"
+#include "pixel_conversion.h"
+#include "scanline_decoder.h"
+#include "unfiltering.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+// Read and check the 8-byte PNG signature
+static bool read_png_signature(png_source_t &source)
+{
+    uint8_t png_header[8];
+    if (!source.read_signature(png_header))
+    {
+        std::cerr << "Error: Not a valid PNG file." << std::endl;
+        return false;
+    }
+
+    // Check if the file is a PNG
+    if (png_header[0] != 0x89 || png_header[1] != 'P' || png_header[2] != 'N' || png_header[3] != 'G' || png_header[4] != 0x0d || png_header[5] != 0x0a || png_header[6] != 0x1a ||
+        png_header[7] != 0x0a)
+    {
+        std::cerr << "Error: Not a valid PNG file." << std::endl;
+        return false;
+    }
+    EPL_LOG(LOG_DEBUG, "Parse PNG header successfully!");
+    return true;
+}
+
+// Parse a chunk that is not part of the image data (IHDR, PLTE and the ancillary chunks), unknown chunks are ignored.
+// Chunk types are compared as FourCC integers, so dispatching is a single switch instead of a string comparison per type.
+static bool parse_metadata_chunk(const png_chunk_t &chunk, png_properties_t &properties)
+{
+    switch (chunk.fourcc)
+    {
+    case CHUNK_IHDR:
+        if (!parse_ihdr_chunk(chunk.buffer, properties.ihdr))
+            return false;
+        EPL_LOG(LOG_INFO, "Image properties:\n" << properties.ihdr);
+        return true;
+    case CHUNK_PLTE:
+        if (!parse_plte_chunk(chunk.buffer, properties.palette))
+            return false;
+        EPL_LOG(LOG_INFO, "Palette: " << properties.palette.size());
+        return true;
+    case CHUNK_pHYs:
+        if (!parse_phys_chunk(chunk.buffer, properties.phys))
+            return false;
+        EPL_LOG(LOG_INFO, "Physical properties:\n" << properties.phys);
+        return true;
+    case CHUNK_bKGD:
+        return parse_bkgd_chunk(chunk.buffer, properties.ihdr.bit_depth, properties.bkgd);
+    case CHUNK_cHRM:
+        return parse_chrm_chunk(chunk.buffer, properties.chrm);
+    case CHUNK_cICP:
+        return parse_cicp_chunk(chunk.buffer);
+    case CHUNK_dSIG:
+        return parse_dsig_chunk(chunk.buffer);
+    case CHUNK_eXIf:
+        return parse_exif_chunk(chunk.buffer);
+    case CHUNK_gAMA:
+        return parse_gama_chunk(chunk.buffer);
+    case CHUNK_hIST:
+        return parse_hist_chunk(chunk.buffer);
+    case CHUNK_iCCP:
+        return parse_iccp_chunk(chunk.buffer);
+    case CHUNK_iDOT:
+        return true; // Only read for parallel inflate, which needs the file offset
+    case CHUNK_iTXt:
+        return parse_itxt_chunk(chunk.buffer, properties.text, properties.scratch);
+    case CHUNK_sBIT:
+        return parse_sbit_chunk(chunk.buffer);
+    case CHUNK_sPLT:
+        return parse_splt_chunk(chunk.buffer);
+    case CHUNK_sRGB:
+        return parse_srgb_chunk(chunk.buffer);
+    case CHUNK_sTER:
+        return parse_ster_chunk(chunk.buffer);
+    case CHUNK_tEXt:
+        return parse_text_chunk(chunk.buffer, properties.text);
+    case CHUNK_tIME:
+        return parse_time_chunk(chunk.buffer);
+    case CHUNK_tRNS:
+        return parse_trns_chunk(chunk.buffer, properties.ihdr.color_type, properties.trns);
+    case CHUNK_zTXt:
+        return parse_ztxt_chunk(chunk.buffer, properties.text, properties.scratch);
+    default:
+        return true;
+    }
+}
+
+// Whether a chunk is worth reading: built-in and registered chunks are, other ancillary chunks are skipped in a single
+// seek (next_chunk moves past their data and CRC), and an unknown critical chunk makes the image undecodable
+static bool chunk_wanted(const png_chunk_t &chunk, const chunk_handlers_t *handlers, const chunk_handler_t *&handler, bool &failed)
+{
+    handler = nullptr;
+    failed = false;
+    if (is_builtin_chunk(chunk.fourcc))
+        return true;
+    if (handlers != nullptr && (handler = find_chunk_handler(*handlers, chunk.fourcc)) != nullptr)
+        return true;
+    if (is_critical_chunk(chunk.fourcc))
+    {
+        std::cerr << "Error: Unknown critical chunk " << std::string(chunk.type, 4) << "!" << std::endl;
+        failed = true;
+    }
+    return false;
+}
+
+// Byte limit of the image buffers, which a size_t must also be able to hold
+static size_t image_byte_limit(const decode_options_t &options)
+{
+    return static_cast<size_t>(std::min<uint64_t>(options.max_image_bytes, SIZE_MAX));
+}
+
+// Set up the output of the region (the caller's buffer, or properties.pixels without an allocator) and prepare the
+// scanline decoder to unfilter and convert rows into it
+static bool begin_image(decoder_context_t &context, png_properties_t &properties, const decode_options_t &options, const region_t &region, const output_allocator_t &allocate)
+{
+    // Thumbnails are reduced from whole-byte samples
+    const bool scaled = options.scale_denominator != 1;
+    decode_options_t converter_options = options;
+    converter_options.unpack_sub_byte |= scaled;
+
+    row_converter_t &converter = context.converter;
+    context.decoder.stats = &properties.stats;
+    if (!setup_row_converter(converter, properties, converter_options))
+        return false;
+
+    const IHDR_t &ihdr = properties.ihdr;
+    pixel_layout_t &layout = properties.layout;
+    layout = converter.layout;
+    layout.width = scaled_size(region.width, options.scale_denominator);
+    layout.height = scaled_size(region.height, options.scale_denominator);
+    layout.row_stride = (static_cast<size_t>(layout.width) * layout.channels * layout.bit_depth + 7) / 8;
+    if (layout.height != 0 && layout.row_stride > image_byte_limit(options) / layout.height)
+    {
+        std::cerr << "Error: Output of " << layout.width << "x" << layout.height << " pixels exceeds max_image_bytes!" << std::endl;
+        return false;
+    }
+
+    image_view_t output = {};
+    if (allocate)
+    {
+        if (!allocate(ihdr, layout, output))
+            return false;
+        if (output.data == nullptr || output.width != layout.width || output.height != layout.height || output.row_stride < layout.row_stride)
+        {
+            std::cerr << "Error: Output buffer does not fit the image!" << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        properties.pixels.resize(layout.row_stride * layout.height);
+        output = {properties.pixels.data(), layout.row_stride, layout.width, layout.height};
+    }
+
+    // Packed pixels are written bit by bit when they are scattered or cropped, start from clean padding bits
+    const bool whole_image = region.width == ihdr.width && region.height == ihdr.height;
+    if (output_pixel_size(converter) == 0 && (ihdr.interlace_method == 1 || !whole_image))
+        for (uint32_t y = 0; y < layout.height; y++)
+            std::memset(output.data + y * output.row_stride, 0, layout.row_stride);
+
+    if (!scaled)
+        return begin_scanlines(context.decoder, ihdr, output, &converter, &region);
+
+    // Averaging palette indices is meaningless, they are point sampled
+    const bool box_filter = options.box_filter && (ihdr.color_type != 3 || options.expand_palette);
+    if (!begin_scaling(context.scaler, layout, options.samples_16bit == SAMPLE16_BIG_ENDIAN, region.width, region.height, options.scale_denominator, box_filter,
+                       ihdr.interlace_method == 1, output))
+        return false;
+    return begin_scanlines(context.decoder, ihdr, output, &converter, &region, &context.scaler);
+}
+
+bool decode_png(png_source_t &source, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png(source, properties, output_allocator_t(), options);
+}
+
+bool decode_png(png_source_t &source, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options)
+{
+    decoder_context_t context;
+    return decode_png(source, properties, context, allocate, options);
+}
+
+// Read every chunk of an image and decode it, decode_png adds the totals of the stats around it
+static bool read_png(png_source_t &source, png_properties_t &properties, decoder_context_t &context, const output_allocator_t &allocate, const decode_options_t &options)
+{
+    // The same properties may be reused across images
+    clear_png_properties(properties);
+    context.images++;
+
+    if (!read_png_signature(source))
+        return false;
+
+    // Inflate state shared by all IDAT chunks in streaming mode, whole-buffer backends inflate the concatenated chunks at IEND
+    const inflate_backend_t *backend = find_inflate_backend(options.inflate_backend);
+    if (backend == nullptr)
+    {
+        std::cerr << "Error: Inflate backend is not built in!" << std::endl;
+        return false;
+    }
+    bool streaming = options.streaming_inflate && backend->stream_begin != nullptr;
+    bool fused = streaming && options.fused_unfilter;
+    idat_inflater_t &inflater = context.inflater;
+    fused_inflater_t &fused_inflater = context.fused_inflater;
+
+    // Images whose IDAT data can be split at restart points are gathered and inflated on several threads at IEND,
+    // which is decided on the first IDAT chunk (see parallel_inflate.h)
+    parallel_inflater_t &parallel_inflater = context.parallel_inflater;
+    bool parallel = false;
+    begin_parallel_inflate(parallel_inflater);
+    uint64_t next_chunk_offset = 8; // Restart points are matched to iDOT segments by file offset
+
+    // Part of the image to decode and size of the start of the decompressed stream it needs, set on the first IDAT chunk
+    region_t region = {};
+    size_t inflate_size = 0;
+    bool truncated = false;
+
+    // IDAT CRCs checked on a helper thread, joined once the image is decoded
+    crc_checker_t crc_checker;
+    const bool background_crc = options.parallel_crc && source.stable_chunk_data();
+
+    // Read chunks
+    png_chunk_t chunk;
+    bool iend_reached = false;
+    while (!iend_reached && source.next_chunk(chunk))
+    {
+        const bool is_idat = chunk.fourcc == CHUNK_IDAT;
+        const uint64_t chunk_offset = next_chunk_offset;
+        next_chunk_offset += 12 + static_cast<uint64_t>(chunk.length);
+
+        // Once the last row of the region has been inflated, the rest of the image data is skipped without being read.
+        // Only the streaming inflaters are begun on the first IDAT chunk: otherwise `finished` is left from the previous
+        // image of the context until the data is inflated at IEND.
+        if (is_idat && truncated && (fused ? fused_inflater.finished : streaming && inflater.finished))
+        {
+            EPL_STATS(properties.stats.skipped_chunks++);
+            continue;
+        }
+
+        const chunk_handler_t *handler;
+        bool failed;
+        if (!chunk_wanted(chunk, options.chunk_handlers, handler, failed))
+        {
+            if (failed)
+                return false;
+            EPL_STATS(properties.stats.skipped_chunks++);
+            continue;
+        }
+
+        // Scratch memory only lives while one chunk is parsed
+        reset_scratch(properties.scratch);
+
+        // Chunk views point into the mapping for memory sources, so this does not copy anything
+        {
+            EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_READ);
+            if (!source.read_chunk_data(chunk))
+                return false;
+        }
+        EPL_STATS(properties.stats.chunks++);
+        EPL_STATS(properties.stats.bytes_in += 12 + static_cast<uint64_t>(chunk.length));
+        if (crc_wanted(options.crc_policy, chunk.fourcc))
+        {
+            if (is_idat && background_crc)
+            {
+                if (crc_checker.failed())
+                {
+                    EPL_STATS(properties.stats.crc_failures++);
+                    return false;
+                }
+                crc_checker.submit(chunk);
+            }
+            else
+            {
+                EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_CRC);
+                if (!verify_chunk_crc(chunk))
+                {
+                    EPL_STATS(properties.stats.crc_failures++);
+                    return false;
+                }
+            }
+        }
+
+        if (is_idat)
+        {
+            // Fused mode unfilters rows as soon as they are inflated, so the output is set up on the first IDAT chunk (PLTE
+            // and tRNS, which the conversion depends on, come before it). Otherwise the inflater allocates the
+            // decompressed image, whose size is known from IHDR, once on the first IDAT chunk.
+            if (inflate_size == 0)
+            {
+                if (!resolve_region(properties.ihdr, options.region, region))
+                    return false;
+                if (!inflated_rows_size_within(properties.ihdr, region.y + region.height, image_byte_limit(options), inflate_size))
+                {
+                    std::cerr << "Error: Image data of " << properties.ihdr.width << "x" << properties.ihdr.height << " pixels exceeds max_image_bytes!" << std::endl;
+                    return false;
+                }
+                truncated = inflate_size < inflated_image_size(properties.ihdr);
+
+                // Rows are unfiltered in bands of the whole image, so only full-size non-interlaced decodes are split
+                const IHDR_t &ihdr = properties.ihdr;
+                parallel = options.inflate_threads != 1 && ihdr.interlace_method == 0 && options.scale_denominator == 1 && region.x == 0 && region.y == 0 &&
+                           region.width == ihdr.width && region.height == ihdr.height;
+                if (parallel)
+                    streaming = fused = false;
+
+                if (fused)
+                {
+                    if (!begin_image(context, properties, options, region, allocate) || !begin_fused_inflate(fused_inflater, context.decoder, truncated, backend, image_byte_limit(options)))
+                        return false;
+                }
+                else if (streaming && !begin_idat_inflate(inflater, inflate_size, truncated, backend))
+                    return false;
+            }
+
+            EPL_STATS(properties.stats.idat_chunks++);
+            EPL_STATS(properties.stats.compressed_bytes += chunk.length);
+            if (parallel)
+                note_idat_chunk(parallel_inflater, properties.compressed_data, chunk_offset, scanline_stride(properties.ihdr, properties.ihdr.width) + 1);
+            bool parsed;
+            {
+                // The fused inflater times its inflate and unfilter stages itself, without streaming the data is only gathered here
+                EPL_TIME_STAGE(fused ? nullptr : &properties.stats, streaming ? DECODE_STAGE_INFLATE : DECODE_STAGE_READ);
+                parsed = fused       ? parse_idat_chunk(chunk.buffer, fused_inflater)
+                         : streaming ? parse_idat_chunk(chunk.buffer, inflater)
+                                     : parse_idat_chunk(chunk.buffer, properties.compressed_data);
+            }
+            if (!parsed)
+                return false;
+        }
+        else if (chunk.fourcc == CHUNK_IEND)
+        {
+            if (parse_iend_chunk(chunk.buffer))
+            {
+                iend_reached = true;
+
+                // End reading png image
+                if (inflate_size == 0)
+                {
+                    std::cerr << "Error: Missing IDAT chunk!" << std::endl;
+                    return false;
+                }
+                EPL_STATS(properties.stats.inflated_bytes = inflate_size);
+
+                // A stream that does not split is inflated serially below
+                bool split = false;
+                if (parallel)
+                {
+                    EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_INFLATE);
+                    split = inflate_segments(parallel_inflater, properties.compressed_data, inflate_size, options.inflate_threads);
+                }
+
+                // Decompress IDAT data (in streaming mode it has already been inflated chunk by chunk)
+                if (fused)
+                {
+                    if (!finish_fused_inflate(fused_inflater))
+                        return false;
+                }
+                else if (split)
+                {
+                    if (!begin_image(context, properties, options, region, allocate) || !unfilter_segments(parallel_inflater, context.decoder))
+                        return false;
+                }
+                else
+                {
+                    if (streaming)
+                    {
+                        if (!finish_idat_inflate(inflater, properties.decompressed_data))
+                            return false;
+                    }
+                    else if (backend->stream_begin != nullptr)
+                    {
+                        // The context's stream is reset rather than set up again for every image
+                        EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_INFLATE);
+                        const std::vector<uint8_t> &compressed = properties.compressed_data;
+                        if (!begin_idat_inflate(inflater, inflate_size, truncated, backend) || !feed_idat_data(inflater, compressed.data(), compressed.size()) ||
+                            !finish_idat_inflate(inflater, properties.decompressed_data))
+                            return false;
+                    }
+                    else
+                    {
+                        EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_INFLATE);
+                        if (!decompress_idat_data(properties.compressed_data, inflate_size, properties.decompressed_data, truncated, backend))
+                            return false;
+                    }
+
+                    // Reverse the scanline filters to get the pixels, converting each row to the output layout
+                    if (!begin_image(context, properties, options, region, allocate) ||
+                        !push_scanlines(context.decoder, properties.decompressed_data.data(), properties.decompressed_data.size()))
+                        return false;
+                }
+                if (!crc_checker.finish())
+                {
+                    EPL_STATS(properties.stats.crc_failures++);
+                    return false;
+                }
+            }
+            else
+                return false;
+        }
+        else if (chunk.fourcc == CHUNK_iDOT && options.inflate_threads != 1 && inflate_size == 0)
+        {
+            EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_METADATA);
+            if (!parse_idot_chunk(chunk.buffer, chunk_offset, properties.ihdr, parallel_inflater.idot))
+                return false;
+        }
+        else
+        {
+            EPL_TIME_STAGE(&properties.stats, DECODE_STAGE_METADATA);
+            if (handler != nullptr ? !(*handler)(chunk, properties) : !parse_metadata_chunk(chunk, properties))
+                return false;
+        }
+    }
+
+    if (!iend_reached)
+    {
+        std::cerr << "Error: Missing IEND chunk!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// read_png, with an allocation that fails (out of memory, or a size the allocator cannot represent) failing the decoding
+static bool read_png_checked(png_source_t &source, png_properties_t &properties, decoder_context_t &context, const output_allocator_t &allocate, const decode_options_t &options)
+{
+    try
+    {
+        return read_png(source, properties, context, allocate, options);
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Error: Out of memory while decoding!" << std::endl;
+    }
+    catch (const std::length_error &)
+    {
+        std::cerr << "Error: Image buffer is too large to allocate!" << std::endl;
+    }
+    return false;
+}
+
+bool decode_png(png_source_t &source, png_properties_t &properties, decoder_context_t &context, const output_allocator_t &allocate, const decode_options_t &options)
+{
+#ifdef EPL_WITH_STATS
+    // Counters running across images, the difference is what this decode did
+    const uint64_t buffer_allocations = byte_buffer_allocations;
+    const scratch_stats_t scratch = properties.scratch.stats;
+    uint64_t total_ns = 0;
+    bool decoded;
+    {
+        stage_timer_t timer(&total_ns);
+        decoded = read_png_checked(source, properties, context, allocate, options);
+    }
+
+    decode_stats_t &stats = properties.stats;
+    stats.total_ns = total_ns;
+    stats.bytes_out = decoded ? properties.layout.row_stride * properties.layout.height : 0;
+    stats.buffer_allocations = static_cast<uint32_t>(byte_buffer_allocations - buffer_allocations);
+    stats.scratch_allocations = static_cast<uint32_t>(properties.scratch.stats.allocations - scratch.allocations);
+    stats.scratch_heap_allocations = static_cast<uint32_t>(properties.scratch.stats.heap_allocations - scratch.heap_allocations);
+    return decoded;
+#else
+    return read_png_checked(source, properties, context, allocate, options);
+#endif
+}
+
+bool probe_png(png_source_t &source, png_properties_t &properties, uint32_t fields)
+{
+    clear_png_properties(properties);
+
+    if (!read_png_signature(source))
+        return false;
+
+    // Fields whose value is final: pHYs, PLTE and tRNS must come before the first IDAT chunk, text chunks can be anywhere
+    uint32_t known = 0;
+    png_chunk_t chunk;
+    while ((known & fields) != fields && source.next_chunk(chunk))
+    {
+        // Image data is never read: the next call to next_chunk seeks over it
+        if (chunk.fourcc == CHUNK_IDAT)
+        {
+            known |= PROBE_PHYS | PROBE_PALETTE;
+            continue;
+        }
+        if (chunk.fourcc == CHUNK_IEND)
+        {
+            known = PROBE_ALL;
+            break;
+        }
+
+        // Unknown chunks are skipped unread as well
+        if (!is_builtin_chunk(chunk.fourcc))
+            continue;
+        reset_scratch(properties.scratch);
+        if (!source.read_chunk_data(chunk) || !verify_chunk_crc(chunk) || !parse_metadata_chunk(chunk, properties))
+            return false;
+        if (chunk.fourcc == CHUNK_IHDR)
+            known |= PROBE_HEADER;
+        else if (chunk.fourcc == CHUNK_pHYs)
+            known |= PROBE_PHYS;
+    }
+
+    if ((known & PROBE_HEADER) == 0)
+    {
+        std::cerr << "Error: Missing IHDR chunk!" << std::endl;
+        return false;
+    }
+    if ((known & fields) != fields)
+    {
+        std::cerr << "Error: Missing IEND chunk!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool probe_png_file(const char *path, png_properties_t &properties, uint32_t fields)
+{
+    // Only chunk headers and metadata are touched, reading ahead would pull the skipped image data from disk
+    mapped_file_source_t source;
+    if (!source.open(path, false))
+        return false;
+    return probe_png(source, properties, fields);
+}
+
+bool probe_png_memory(std::span<const uint8_t> data, png_properties_t &properties, uint32_t fields)
+{
+    memory_source_t source(data.data(), data.size());
+    return probe_png(source, properties, fields);
+}
+
+bool decode_png_into(png_source_t &source, png_properties_t &properties, const image_view_t &output, const decode_options_t &options)
+{
+    return decode_png(
+        source, properties,
+        [&output](const IHDR_t &, const pixel_layout_t &, image_view_t &view) {
+            view = output;
+            return true;
+        },
+        options);
+}
+
+bool decode_png_file(const char *path, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png_file(path, properties, output_allocator_t(), options);
+}
+
+bool decode_png_file(const char *path, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options)
+{
+    mapped_file_source_t source;
+    if (!source.open(path))
+        return false;
+    return decode_png(source, properties, allocate, options);
+}
+
+bool decode_png_file(const char *path, png_properties_t &properties, decoder_context_t &context, const decode_options_t &options)
+{
+    mapped_file_source_t source;
+    if (!source.open(path))
+        return false;
+    return decode_png(source, properties, context, output_allocator_t(), options);
+}
+
+bool decode_png_memory(const uint8_t *data, size_t size, png_properties_t &properties, const decode_options_t &options)
+{
+    memory_source_t source(data, size);
+    return decode_png(source, properties, options);
+}
+
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png_memory(data.data(), data.size(), properties, options);
+}
+
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options)
+{
+    memory_source_t source(data.data(), data.size());
+    return decode_png(source, properties, allocate, options);
+}
+
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, decoder_context_t &context, const decode_options_t &options)
+{
+    memory_source_t source(data.data(), data.size());
+    return decode_png(source, properties, context, output_allocator_t(), options);
+}
+
+bool decode_png_file(std::ifstream &stream, png_properties_t &properties, const decode_options_t &options)
+{
+    stream_source_t source(stream, &properties.scratch);
+    return decode_png(source, properties, options);
+}
@@ -0,0 +1,67 @@
+#ifndef __PNG_DECODER_H__
+#define __PNG_DECODER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <span>
+
+#include "decode_options.h"
+#include "png_properties.h"
+#include "png_source.h"
+#include "scanline_decoder.h"
+
+// Provides the caller-owned buffer the pixels are decoded into, once the image size and output layout are known.
+// `output` must hold layout.width * layout.height pixels of `layout`; its rows may be padded (row_stride >= layout.row_stride).
+// Returning false aborts the decoding.
+typedef std::function<bool(const IHDR_t &ihdr, const pixel_layout_t &layout, image_view_t &output)> output_allocator_t;
+
+// Metadata a probe reads, as a bit mask
+enum probe_fields_t : uint32_t
+{
+    PROBE_HEADER = 1u << 0,  // IHDR: size, bit depth, color type, interlacing
+    PROBE_PHYS = 1u << 1,    // pHYs
+    PROBE_PALETTE = 1u << 2, // PLTE and tRNS
+    PROBE_TEXT = 1u << 3,    // tEXt, zTXt and iTXt (they may follow the image data, so this reads up to IEND)
+    PROBE_ALL = 0xFFFFFFFFu, // Every metadata chunk up to IEND
+};
+
+// Read the metadata of a PNG image without decoding it: IDAT payloads are skipped without being read, CRC-checked
+// or inflated, and the chunk walk stops as soon as every requested field is known.
+// Only the metadata of `properties` is filled; fields that are absent from the file are left zeroed.
+bool probe_png(png_source_t &source, png_properties_t &properties, uint32_t fields = PROBE_ALL);
+bool probe_png_file(const char *path, png_properties_t &properties, uint32_t fields = PROBE_ALL);
+bool probe_png_memory(std::span<const uint8_t> data, png_properties_t &properties, uint32_t fields = PROBE_ALL);
+
+// Decode a PNG image from any input source
+bool decode_png(png_source_t &source, png_properties_t &properties, const decode_options_t &options = {});
+
+// Decode a PNG image straight into a caller-owned buffer: every row is unfiltered and converted directly into it,
+// properties.pixels is left empty
+bool decode_png(png_source_t &source, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options = {});
+
+typedef struct _decoder_context decoder_context_t;
+
+// Decode reusing the inflate stream, buffers and tables of the previous images decoded with the same context (see decoder_context.h)
+bool decode_png(png_source_t &source, png_properties_t &properties, decoder_context_t &context, const output_allocator_t &allocate = {}, const decode_options_t &options = {});
+
+// Decode into a buffer of a known size, which fails if the image (or the requested region) does not have the same size
+bool decode_png_into(png_source_t &source, png_properties_t &properties, const image_view_t &output, const decode_options_t &options = {});
+
+// Decode a PNG file through a read-only memory mapping (no intermediate copies of the chunk data)
+bool decode_png_file(const char *path, png_properties_t &properties, const decode_options_t &options = {});
+bool decode_png_file(const char *path, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options = {});
+bool decode_png_file(const char *path, png_properties_t &properties, decoder_context_t &context, const decode_options_t &options = {});
+
+// Decode a PNG image that is already in memory (e.g. a payload received over RPC or a message queue).
+// The chunk parsers and inflate read the caller's bytes in place, which must stay valid during the call.
+bool decode_png_memory(const uint8_t *data, size_t size, png_properties_t &properties, const decode_options_t &options = {});
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, const decode_options_t &options = {});
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, const output_allocator_t &allocate, const decode_options_t &options = {});
+bool decode_png_memory(std::span<const uint8_t> data, png_properties_t &properties, decoder_context_t &context, const decode_options_t &options = {});
+
+// Decode a PNG file from an already opened stream
+bool decode_png_file(std::ifstream &stream, png_properties_t &properties, const decode_options_t &options = {});
+
+#endif // __PNG_DECODER_H__
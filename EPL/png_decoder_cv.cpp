@@ -0,0 +1,48 @@
+#include "png_decoder_cv.h"
+#include <iostream>
+
+// The options a Mat can represent: OpenCV channel order and layouts (cv::imdecode has no gray + alpha one), byte-aligned
+// native-endian samples
+static decode_options_t mat_options(const decode_options_t &options)
+{
+    decode_options_t mat_options = options;
+    mat_options.bgr_order = true;
+    mat_options.expand_gray_alpha = true;
+    mat_options.unpack_sub_byte = true;
+    if (mat_options.samples_16bit == SAMPLE16_BIG_ENDIAN)
+        mat_options.samples_16bit = SAMPLE16_NATIVE;
+    return mat_options;
+}
+
+// Point the decoder at the Mat's own buffer, allocating it only if needed
+static output_allocator_t mat_allocator(cv::Mat &mat)
+{
+    return [&mat](const IHDR_t &, const pixel_layout_t &layout, image_view_t &output) {
+        const int depth = layout.bit_depth == 16 ? CV_16U : CV_8U;
+        const int rows = static_cast<int>(layout.height);
+        const int cols = static_cast<int>(layout.width);
+        if (rows < 0 || cols < 0)
+        {
+            std::cerr << "Error: Image is too large for a cv::Mat!" << std::endl;
+            return false;
+        }
+        mat.create(rows, cols, CV_MAKETYPE(depth, static_cast<int>(layout.channels)));
+        output = {mat.data, mat.step[0], layout.width, layout.height};
+        return true;
+    };
+}
+
+bool decode_png_mat(png_source_t &source, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png(source, properties, mat_allocator(mat), mat_options(options));
+}
+
+bool decode_png_mat(const char *path, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png_file(path, properties, mat_allocator(mat), mat_options(options));
+}
+
+bool decode_png_mat(std::span<const uint8_t> data, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options)
+{
+    return decode_png_memory(data, properties, mat_allocator(mat), mat_options(options));
+}
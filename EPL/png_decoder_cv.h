@@ -0,0 +1,20 @@
+#ifndef __PNG_DECODER_CV_H__
+#define __PNG_DECODER_CV_H__
+
+#include <cstdint>
+#include <span>
+
+#include <opencv2/core.hpp>
+
+#include "decode_options.h"
+#include "png_decoder.h"
+
+// Decode a PNG image straight into `mat`, in OpenCV's conventions: BGR/BGRA channel order, gray + alpha expanded to
+// BGRA, native-endian CV_16U for 16-bit images, one byte per sample for 1, 2 and 4-bit images.
+// `mat` is only (re)allocated when its size or type does not match, so a preallocated Mat, or a ROI of a larger Mat
+// with padded rows, receives the pixels in place without any intermediate copy.
+bool decode_png_mat(png_source_t &source, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options = {});
+bool decode_png_mat(const char *path, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options = {});
+bool decode_png_mat(std::span<const uint8_t> data, cv::Mat &mat, png_properties_t &properties, const decode_options_t &options = {});
+
+#endif // __PNG_DECODER_CV_H__
@@ -1,5 +1,22 @@
 #include "png_properties.h"
 
+void clear_png_properties(png_properties_t &properties)
+{
+    properties.ihdr = {};
+    properties.phys = {};
+    properties.bkgd = {};
+    properties.chrm = {};
+    properties.trns = {};
+    properties.layout = {};
+    properties.palette.clear();
+    properties.text.clear();
+    properties.compressed_data.clear();
+    properties.decompressed_data.clear();
+    properties.pixels.clear();
+    reset_scratch(properties.scratch);
+    properties.stats = {};
+}
+
 std::ostream &operator<<(std::ostream &os, const IHDR_t &ihdr)
 {
     os << "\tWidth: " << ihdr.width << "\n"
@@ -3,8 +3,13 @@
 
 // Structure to store PNG properties
 #include <iostream>
+#include <string>
 #include <vector>
 
+#include "byte_buffer.h"
+#include "decode_stats.h"
+#include "scratch_arena.h"
+
 typedef struct _IHDR
 {
     uint32_t width;
@@ -61,6 +66,35 @@ typedef struct _cHRM
     uint32_t white_y;
 } cHRM_t;
 
+// Transparency information, interpreted according to the color type
+typedef struct _tRNS
+{
+    bool present;
+    uint16_t gray;                // Transparent gray level (grayscale images)
+    uint16_t red;                 // Transparent color (truecolor images)
+    uint16_t green;
+    uint16_t blue;
+    uint16_t palette_alpha_count; // Number of palette entries with an alpha value (indexed images)
+    uint8_t palette_alpha[256];   // The remaining entries are opaque
+} tRNS_t;
+
+// Textual information from a tEXt, zTXt or iTXt chunk (decompressed)
+typedef struct _text
+{
+    std::string keyword;
+    std::string text; // Latin-1 for tEXt and zTXt, UTF-8 for iTXt
+} text_t;
+
+// Layout of the decoded pixels
+typedef struct _pixel_layout
+{
+    uint32_t width;     // Size of the output image (the region when only part of the image is decoded)
+    uint32_t height;
+    uint32_t channels;  // Samples per pixel
+    uint8_t bit_depth;  // Bits per sample (1, 2 and 4-bit samples are packed, most significant bits first)
+    size_t row_stride;  // Bytes per row
+} pixel_layout_t;
+
 // Png file properties
 typedef struct _png_properties
 {
@@ -68,11 +102,20 @@ typedef struct _png_properties
     pHYs_t phys;
     bKGD_t bkgd; // Background color for non-indexed images
     cHRM_t chrm; // Chromaticity information
+    tRNS_t trns;
     std::vector<RGB_t> palette;
+    std::vector<text_t> text;
     std::vector<uint8_t> compressed_data;
-    std::vector<uint8_t> decompressed_data;
+    byte_buffer_t decompressed_data;
+    pixel_layout_t layout;
+    byte_buffer_t pixels; // Decoded rows, see layout (indexed images are expanded to RGB/RGBA unless disabled)
+    scratch_arena_t scratch; // Per-chunk scratch memory of the chunk parsers and custom chunk handlers, kept between images
+    decode_stats_t stats;    // Timers and counters of the last decode (collected with EPL_WITH_STATS only)
 } png_properties_t;
 
+// Reset the properties before decoding another image, keeping the capacity of their buffers
+void clear_png_properties(png_properties_t &properties);
+
 // Overload the << operator
 std::ostream &operator<<(std::ostream &os, const IHDR_t &ihdr);
 std::ostream &operator<<(std::ostream &os, const pHYs_t &phys);
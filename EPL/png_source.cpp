@@ -0,0 +1,194 @@
+#include "png_source.h"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Chunk lengths are limited to 2^31 - 1 bytes by the PNG standard
+static const uint32_t MAX_CHUNK_LENGTH = 0x7FFFFFFF;
+
+static uint32_t read_be32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// memory_source_t
+// ---------------------------------------------------------------------------------------------------------------------
+
+memory_source_t::memory_source_t(const uint8_t *data, size_t size) : data(data), size(size)
+{
+}
+
+bool memory_source_t::read_signature(uint8_t signature[8])
+{
+    if (size < 8)
+        return false;
+    std::memcpy(signature, data, 8);
+    offset = 8;
+    return true;
+}
+
+bool memory_source_t::next_chunk(png_chunk_t &chunk)
+{
+    // Not even room for a chunk header: end of the input
+    if (offset + 8 > size)
+        return false;
+
+    chunk.length = read_be32(data + offset);
+    std::memcpy(chunk.type, data + offset + 4, 4);
+    chunk.fourcc = read_be32(data + offset + 4);
+    chunk.buffer = {};
+    if (chunk.length > MAX_CHUNK_LENGTH || size - offset - 8 < static_cast<size_t>(chunk.length) + 4)
+    {
+        std::cerr << "Error: Truncated or invalid " << std::string(chunk.type, 4) << " chunk!" << std::endl;
+        return false;
+    }
+
+    data_begin = offset + 8;
+    offset = data_begin + chunk.length + 4;
+    return true;
+}
+
+bool memory_source_t::read_chunk_data(png_chunk_t &chunk)
+{
+    // Zero-copy: the view points into the input bytes
+    chunk.buffer = std::span<const uint8_t>(data + data_begin, chunk.length + 4);
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// mapped_file_t
+// ---------------------------------------------------------------------------------------------------------------------
+
+mapped_file_t::~mapped_file_t()
+{
+    close();
+}
+
+bool mapped_file_t::open(const char *path, bool sequential)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Error opening PNG file." << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        std::cerr << "Error: PNG file is empty or cannot be read." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Error mapping PNG file." << std::endl;
+        return false;
+    }
+
+    // Chunks are walked front to back, so let the kernel read ahead aggressively (unless only chunk headers are read)
+    madvise(mapping, static_cast<size_t>(st.st_size), sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    bytes = static_cast<const uint8_t *>(mapping);
+    length = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void mapped_file_t::close()
+{
+    if (bytes != nullptr)
+        munmap(const_cast<uint8_t *>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// mapped_file_source_t
+// ---------------------------------------------------------------------------------------------------------------------
+
+mapped_file_source_t::mapped_file_source_t() : memory_source_t(nullptr, 0)
+{
+}
+
+bool mapped_file_source_t::open(const char *path, bool sequential)
+{
+    if (!file.open(path, sequential))
+        return false;
+    data = file.data();
+    size = file.size();
+    offset = 0;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// stream_source_t
+// ---------------------------------------------------------------------------------------------------------------------
+
+stream_source_t::stream_source_t(std::ifstream &stream, scratch_arena_t *scratch) : stream(stream), scratch(scratch)
+{
+    next_offset = static_cast<std::streamoff>(stream.tellg()) + 8;
+}
+
+bool stream_source_t::read_signature(uint8_t signature[8])
+{
+    stream.read(reinterpret_cast<char *>(signature), 8);
+    return stream.gcount() == 8;
+}
+
+bool stream_source_t::next_chunk(png_chunk_t &chunk)
+{
+    // Seek over whatever is left of the previous chunk
+    stream.clear();
+    stream.seekg(next_offset);
+
+    uint8_t header[8];
+    stream.read(reinterpret_cast<char *>(header), 8);
+    if (stream.gcount() != 8)
+        return false; // Stop if we can't read a whole header (end of file)
+
+    chunk.length = read_be32(header);
+    std::memcpy(chunk.type, header + 4, 4);
+    chunk.fourcc = read_be32(header + 4);
+    chunk.buffer = {};
+    if (chunk.length > MAX_CHUNK_LENGTH)
+    {
+        std::cerr << "Error: Invalid " << std::string(chunk.type, 4) << " chunk length!" << std::endl;
+        return false;
+    }
+
+    next_offset += 8 + static_cast<std::streamoff>(chunk.length) + 4;
+    return true;
+}
+
+bool stream_source_t::read_chunk_data(png_chunk_t &chunk)
+{
+    const size_t size = static_cast<size_t>(chunk.length) + 4;
+    uint8_t *data;
+    if (scratch != nullptr)
+        data = static_cast<uint8_t *>(scratch_alloc(*scratch, size));
+    else
+    {
+        buffer.resize(size);
+        data = buffer.data();
+    }
+
+    stream.read(reinterpret_cast<char *>(data), size);
+    if (static_cast<size_t>(stream.gcount()) != size)
+    {
+        std::cerr << "Error: Truncated " << std::string(chunk.type, 4) << " chunk!" << std::endl;
+        return false;
+    }
+    chunk.buffer = std::span<const uint8_t>(data, size);
+    return true;
+}
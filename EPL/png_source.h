@@ -0,0 +1,124 @@
+#ifndef __PNG_SOURCE_H__
+#define __PNG_SOURCE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "scratch_arena.h"
+
+// A chunk as seen by the decoder: the header fields, plus a view of the chunk data followed by its 4-byte CRC
+// once read_chunk_data() has been called
+typedef struct _png_chunk
+{
+    uint32_t length;
+    char type[4];
+    uint32_t fourcc; // The type as a big-endian integer, see chunk_types.h
+    std::span<const uint8_t> buffer;
+} png_chunk_t;
+
+// Input the decoder reads the PNG signature and chunks from
+class png_source_t
+{
+  public:
+    virtual ~png_source_t() = default;
+
+    // Read the 8-byte PNG signature
+    virtual bool read_signature(uint8_t signature[8]) = 0;
+
+    // Read the header of the next chunk, skipping whatever is left of the current one.
+    // Returns false at the end of the input.
+    virtual bool next_chunk(png_chunk_t &chunk) = 0;
+
+    // Make chunk.buffer point at the chunk data and CRC. The view stays valid until the next call on this source.
+    virtual bool read_chunk_data(png_chunk_t &chunk) = 0;
+
+    // Whether chunk views stay valid for the whole lifetime of the source, so other threads may still read them
+    // while the next chunks are being read
+    virtual bool stable_chunk_data() const
+    {
+        return false;
+    }
+};
+
+// Source over PNG bytes that are already in memory: chunk views point straight into the caller's bytes
+class memory_source_t : public png_source_t
+{
+  public:
+    memory_source_t(const uint8_t *data, size_t size);
+
+    bool read_signature(uint8_t signature[8]) override;
+    bool next_chunk(png_chunk_t &chunk) override;
+    bool read_chunk_data(png_chunk_t &chunk) override;
+    bool stable_chunk_data() const override
+    {
+        return true;
+    }
+
+  protected:
+    const uint8_t *data;
+    size_t size;
+    size_t offset = 0;     // Start of the next chunk
+    size_t data_begin = 0; // Start of the current chunk data
+};
+
+// Read-only memory mapping of a whole file
+class mapped_file_t
+{
+  public:
+    mapped_file_t() = default;
+    mapped_file_t(const mapped_file_t &) = delete;
+    mapped_file_t &operator=(const mapped_file_t &) = delete;
+    ~mapped_file_t();
+
+    // `sequential` asks the kernel to read ahead; turn it off when most of the file will be skipped
+    bool open(const char *path, bool sequential = true);
+    void close();
+
+    const uint8_t *data() const
+    {
+        return bytes;
+    }
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+};
+
+// Source over a memory-mapped file: chunk parsers and inflate read directly from the page cache, without any copy
+class mapped_file_source_t : public memory_source_t
+{
+  public:
+    mapped_file_source_t();
+
+    bool open(const char *path, bool sequential = true);
+
+  private:
+    mapped_file_t file;
+};
+
+// Source over a std::ifstream: every chunk is read into a buffer owned by the source, or into the decoder's scratch
+// arena when one is given (the decoder resets it before every chunk, so its memory is reused across chunks and images)
+class stream_source_t : public png_source_t
+{
+  public:
+    explicit stream_source_t(std::ifstream &stream, scratch_arena_t *scratch = nullptr);
+
+    bool read_signature(uint8_t signature[8]) override;
+    bool next_chunk(png_chunk_t &chunk) override;
+    bool read_chunk_data(png_chunk_t &chunk) override;
+
+  private:
+    std::ifstream &stream;
+    std::streamoff next_offset = 8; // Start of the next chunk (the first one follows the signature)
+    scratch_arena_t *scratch;
+    std::vector<uint8_t> buffer;
+};
+
+#endif // __PNG_SOURCE_H__
@@ -0,0 +1,319 @@
+#include "scanline_decoder.h"
+#include "image_scaler.h"
+#include "unfiltering.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// A non-interlaced image is a single "pass" covering every pixel
+static const adam7_pass_t FULL_IMAGE_PASS = {0, 0, 1, 1};
+
+static const adam7_pass_t &current_pass(const scanline_decoder_t &decoder)
+{
+    return decoder.ihdr.interlace_method == 0 ? FULL_IMAGE_PASS : ADAM7_PASSES[decoder.pass];
+}
+
+// Move to the next non-empty pass (or past the last one)
+static void start_pass(scanline_decoder_t &decoder, int pass)
+{
+    const IHDR_t &ihdr = decoder.ihdr;
+    decoder.finished = true;
+    for (; pass < 7; pass++)
+    {
+        // A non-interlaced image is a single "pass"
+        if (ihdr.interlace_method == 0 && pass > 0)
+            return;
+
+        uint32_t width = ihdr.interlace_method == 0 ? ihdr.width : adam7_pass_width(ihdr.width, pass);
+        uint32_t height = ihdr.interlace_method == 0 ? ihdr.height : adam7_pass_height(ihdr.height, pass);
+        if (width != 0 && height != 0)
+        {
+            decoder.pass = pass;
+            decoder.pass_width = width;
+            decoder.pass_height = height;
+            decoder.pass_row = 0;
+            decoder.pass_stride = scanline_stride(ihdr, width);
+            decoder.previous_row = nullptr;
+            decoder.finished = false;
+            return;
+        }
+    }
+}
+
+template <size_t BPP>
+static void scatter_pixels(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t x0, uint32_t dx)
+{
+    dst += static_cast<size_t>(x0) * BPP;
+    for (uint32_t i = 0; i < count; i++, src += BPP, dst += static_cast<size_t>(dx) * BPP)
+        std::memcpy(dst, src, BPP);
+}
+
+// Write `count` pixels of `src`, starting at pixel `first`, to columns x0, x0 + dx, x0 + 2 * dx, ... of an output row
+static void scatter_row(uint8_t *dst, const uint8_t *src, uint32_t first, uint32_t count, uint32_t x0, uint32_t dx, size_t pixel_bits)
+{
+    if (pixel_bits % 8 == 0 && dx == 1)
+    {
+        std::memcpy(dst + x0 * pixel_bits / 8, src + first * pixel_bits / 8, count * pixel_bits / 8);
+        return;
+    }
+
+    const uint8_t *pixels = src + first * pixel_bits / 8;
+    switch (pixel_bits)
+    {
+    case 8:
+        return scatter_pixels<1>(dst, pixels, count, x0, dx);
+    case 16:
+        return scatter_pixels<2>(dst, pixels, count, x0, dx);
+    case 24:
+        return scatter_pixels<3>(dst, pixels, count, x0, dx);
+    case 32:
+        return scatter_pixels<4>(dst, pixels, count, x0, dx);
+    case 48:
+        return scatter_pixels<6>(dst, pixels, count, x0, dx);
+    case 64:
+        return scatter_pixels<8>(dst, pixels, count, x0, dx);
+    }
+
+    // Packed 1, 2 and 4-bit pixels (grayscale and indexed images only have one channel)
+    const uint32_t bits = static_cast<uint32_t>(pixel_bits);
+    const uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = first, x = x0; i < first + count; i++, x += dx)
+    {
+        uint32_t src_bit = i * bits;
+        uint32_t value = (src[src_bit >> 3] >> (8 - bits - (src_bit & 7))) & mask;
+        uint32_t dst_bit = x * bits;
+        uint32_t shift = 8 - bits - (dst_bit & 7);
+        uint8_t &out = dst[dst_bit >> 3];
+        out = static_cast<uint8_t>((out & ~(mask << shift)) | (value << shift));
+    }
+}
+
+// Shift packed pixels so that the bit at `bit_offset` becomes the first bit of `dst`
+static void align_packed_pixels(uint8_t *dst, const uint8_t *src, size_t bit_offset, size_t bit_count)
+{
+    src += bit_offset / 8;
+    const unsigned shift = static_cast<unsigned>(bit_offset % 8);
+    const size_t src_bytes = (bit_offset % 8 + bit_count + 7) / 8;
+    const size_t dst_bytes = (bit_count + 7) / 8;
+    for (size_t i = 0; i < dst_bytes; i++)
+    {
+        const uint8_t next = i + 1 < src_bytes ? src[i + 1] : 0;
+        dst[i] = static_cast<uint8_t>(src[i] << shift | next >> (8 - shift));
+    }
+}
+
+// Write pixels [first, first + count) of an unfiltered scanline to an output row, from column x0 with a step of dx
+static void emit_pixels(scanline_decoder_t &decoder, const uint8_t *row, uint32_t first, uint32_t count, uint8_t *dst, uint32_t x0, uint32_t dx)
+{
+    const size_t pixel_bits = static_cast<size_t>(decoder.ihdr.bit_depth) * decoder.ihdr.channels;
+    const row_converter_t *converter = decoder.converter;
+    if (converter == nullptr)
+        return scatter_row(dst, row, first, count, x0, dx, pixel_bits);
+
+    // Converters read whole bytes, so packed pixels that do not start on a byte boundary are shifted first
+    const uint8_t *src = row + first * pixel_bits / 8;
+    if (first * pixel_bits % 8 != 0)
+    {
+        align_packed_pixels(decoder.aligned_row.data(), row, first * pixel_bits, count * pixel_bits);
+        src = decoder.aligned_row.data();
+    }
+
+    // Converted pixels are always whole bytes
+    const size_t out_size = output_pixel_size(*converter);
+    if (dx == 1)
+        return converter->convert(*converter, src, count, dst + x0 * out_size);
+    converter->convert(*converter, src, count, decoder.converted_row.data());
+    scatter_row(dst, decoder.converted_row.data(), 0, count, x0, dx, out_size * 8);
+}
+
+// Convert pixels [first, first + count) of an unfiltered scanline and hand them to the scaler
+static void scale_scanline(scanline_decoder_t &decoder, const uint8_t *row, uint32_t first, uint32_t count, uint32_t x0, uint32_t dx, uint32_t y)
+{
+    // The scaler only takes whole-byte samples, so without a converter the pixels are used where they are
+    const uint8_t *pixels = row + first * decoder.bpp;
+    if (decoder.converter != nullptr)
+    {
+        emit_pixels(decoder, row, first, count, decoder.converted_row.data(), 0, 1);
+        pixels = decoder.converted_row.data();
+    }
+    scale_pixels(*decoder.scaler, pixels, count, x0, dx, y);
+}
+
+bool resolve_region(const IHDR_t &ihdr, const region_t &requested, region_t &region)
+{
+    if (requested.x >= ihdr.width || requested.y >= ihdr.height || requested.width > ihdr.width - requested.x || requested.height > ihdr.height - requested.y)
+    {
+        std::cerr << "Error: Region is outside the image!" << std::endl;
+        return false;
+    }
+    region.x = requested.x;
+    region.y = requested.y;
+    region.width = requested.width != 0 ? requested.width : ihdr.width - requested.x;
+    region.height = requested.height != 0 ? requested.height : ihdr.height - requested.y;
+    return true;
+}
+
+bool begin_scanlines(scanline_decoder_t &decoder, const IHDR_t &ihdr, const image_view_t &output, const row_converter_t *converter, const region_t *region,
+                     image_scaler_t *scaler)
+{
+    if (ihdr.interlace_method > 1)
+    {
+        std::cerr << "Error: Unknown interlace method " << static_cast<int>(ihdr.interlace_method) << "!" << std::endl;
+        return false;
+    }
+
+    decoder.ihdr = ihdr;
+    decoder.output = output;
+    decoder.converter = converter != nullptr && converter->convert != nullptr ? converter : nullptr;
+    decoder.scaler = scaler;
+    decoder.region = region != nullptr ? *region : region_t{0, 0, ihdr.width, ihdr.height};
+    decoder.bpp = bytes_per_pixel(ihdr);
+    decoder.bytes_left = inflated_rows_size(ihdr, decoder.region.y + decoder.region.height);
+
+    const bool whole_image = decoder.region.x == 0 && decoder.region.y == 0 && decoder.region.width == ihdr.width && decoder.region.height == ihdr.height;
+    decoder.in_place = ihdr.interlace_method == 0 && decoder.converter == nullptr && decoder.scaler == nullptr && whole_image;
+
+    // Interlaced, converted or cropped images keep their scanlines in two row buffers
+    const size_t max_stride = scanline_stride(ihdr, ihdr.width);
+    if (!decoder.in_place)
+    {
+        // The last pass has the widest scanlines: every column of the odd rows
+        decoder.rows[0].resize(max_stride);
+        decoder.rows[1].resize(max_stride);
+    }
+    if (decoder.converter != nullptr && decoder.region.x != 0 && ihdr.bit_depth < 8)
+        decoder.aligned_row.resize(max_stride);
+    if (decoder.converter != nullptr && (ihdr.interlace_method == 1 || decoder.scaler != nullptr))
+        decoder.converted_row.resize(decoder.converter->layout.row_stride);
+
+    start_pass(decoder, 0);
+    if (decoder.bytes_left == 0)
+        decoder.finished = true;
+    return true;
+}
+
+size_t next_scanline_size(const scanline_decoder_t &decoder)
+{
+    return decoder.finished ? 0 : decoder.pass_stride + 1;
+}
+
+bool push_scanline(scanline_decoder_t &decoder, const uint8_t *filtered_row)
+{
+    if (decoder.finished)
+    {
+        std::cerr << "Error: Too many scanlines!" << std::endl;
+        return false;
+    }
+
+    const image_view_t &output = decoder.output;
+    if (decoder.in_place)
+    {
+        // Unfilter straight into the output row, the previous output row is the prediction source
+        uint8_t *dst = output.data + decoder.pass_row * output.row_stride;
+        EPL_TIME_STAGE(decoder.stats, DECODE_STAGE_UNFILTER);
+        if (!unfilter_scanline(filtered_row[0], dst, filtered_row + 1, decoder.previous_row, decoder.pass_stride, decoder.bpp))
+            return false;
+        decoder.previous_row = dst;
+    }
+    else
+    {
+        // Unfilter into the row buffer that does not hold the previous scanline
+        uint8_t *row = decoder.previous_row == decoder.rows[0].data() ? decoder.rows[1].data() : decoder.rows[0].data();
+        {
+            EPL_TIME_STAGE(decoder.stats, DECODE_STAGE_UNFILTER);
+            if (!unfilter_scanline(filtered_row[0], row, filtered_row + 1, decoder.previous_row, decoder.pass_stride, decoder.bpp))
+                return false;
+        }
+        decoder.previous_row = row;
+
+        // Rows above the region are only needed as prediction sources
+        const adam7_pass_t &p = current_pass(decoder);
+        const region_t &region = decoder.region;
+        const uint32_t y = p.y0 + decoder.pass_row * p.dy;
+        const bool row_needed = decoder.scaler == nullptr || scaler_needs_row(*decoder.scaler, y - region.y);
+        if (y >= region.y && y < region.y + region.height && row_needed)
+        {
+            EPL_TIME_STAGE(decoder.stats, DECODE_STAGE_CONVERT);
+            // Scanline pixels i with region.x <= p.x0 + i * p.dx < region.x + region.width
+            const uint32_t first = region.x > p.x0 ? (region.x - p.x0 + p.dx - 1) / p.dx : 0;
+            const uint32_t region_end = region.x + region.width;
+            const uint32_t end = region_end > p.x0 ? std::min(decoder.pass_width, (region_end - p.x0 + p.dx - 1) / p.dx) : 0;
+            if (first < end && decoder.scaler != nullptr)
+                scale_scanline(decoder, row, first, end - first, p.x0 + first * p.dx - region.x, p.dx, y - region.y);
+            else if (first < end)
+                emit_pixels(decoder, row, first, end - first, output.data + (y - region.y) * output.row_stride, p.x0 + first * p.dx - region.x, p.dx);
+        }
+    }
+
+    // Stop as soon as the last scanline the region needs has been decoded
+    decoder.bytes_left -= decoder.pass_stride + 1;
+    if (decoder.bytes_left == 0)
+    {
+        decoder.finished = true;
+        if (decoder.scaler != nullptr)
+        {
+            EPL_TIME_STAGE(decoder.stats, DECODE_STAGE_CONVERT);
+            finish_scaling(*decoder.scaler);
+        }
+    }
+    else if (++decoder.pass_row == decoder.pass_height)
+        start_pass(decoder, decoder.pass + 1);
+    return true;
+}
+
+bool push_scanlines(scanline_decoder_t &decoder, const uint8_t *filtered, size_t filtered_size)
+{
+    // Every scanline is prefixed by its filter type byte
+    if (filtered_size < decoder.bytes_left)
+    {
+        std::cerr << "Error: Decompressed data is too short for the image size!" << std::endl;
+        return false;
+    }
+
+    size_t row_size;
+    while ((row_size = next_scanline_size(decoder)) != 0)
+    {
+        if (!push_scanline(decoder, filtered))
+            return false;
+        filtered += row_size;
+    }
+    return true;
+}
+
+bool seek_scanline(scanline_decoder_t &decoder, uint32_t row)
+{
+    const region_t &region = decoder.region;
+    const bool whole_image = region.x == 0 && region.y == 0 && region.width == decoder.ihdr.width && region.height == decoder.ihdr.height;
+    if (decoder.ihdr.interlace_method != 0 || !whole_image || decoder.scaler != nullptr || row >= decoder.ihdr.height)
+    {
+        std::cerr << "Error: Cannot seek to scanline " << row << "!" << std::endl;
+        return false;
+    }
+
+    decoder.pass_row = row;
+    decoder.previous_row = nullptr;
+    decoder.bytes_left = static_cast<size_t>(decoder.ihdr.height - row) * (decoder.pass_stride + 1);
+    decoder.finished = false;
+    return true;
+}
+
+bool decode_scanlines(const uint8_t *filtered, size_t filtered_size, const IHDR_t &ihdr, const row_converter_t *converter, const image_view_t &output, const region_t *region,
+                      image_scaler_t *scaler)
+{
+    scanline_decoder_t decoder;
+    if (!begin_scanlines(decoder, ihdr, output, converter, region, scaler))
+        return false;
+    return push_scanlines(decoder, filtered, filtered_size);
+}
+
+bool unfilter_image(const uint8_t *filtered, size_t filtered_size, const IHDR_t &ihdr, byte_buffer_t &pixels)
+{
+    const size_t stride = scanline_stride(ihdr, ihdr.width);
+    pixels.resize(stride * ihdr.height);
+
+    // Packed pixels of different passes share bytes, start from clean padding bits
+    if (ihdr.interlace_method == 1 && ihdr.bit_depth < 8)
+        std::memset(pixels.data(), 0, pixels.size());
+
+    return decode_scanlines(filtered, filtered_size, ihdr, nullptr, {pixels.data(), stride, ihdr.width, ihdr.height});
+}
@@ -0,0 +1,85 @@
+#ifndef __SCANLINE_DECODER_H__
+#define __SCANLINE_DECODER_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "pixel_conversion.h"
+#include "png_properties.h"
+
+// Image the scanline decoder writes reconstructed pixels into
+typedef struct _image_view
+{
+    uint8_t *data;
+    size_t row_stride; // Bytes between the starts of two consecutive rows
+    uint32_t width;
+    uint32_t height;
+} image_view_t;
+
+typedef struct _image_scaler image_scaler_t;
+
+// Row-by-row decoding state: scanlines are pushed one at a time (filter type byte + filtered bytes), in the order
+// they appear in the decompressed stream, and are unfiltered and written to the output image right away.
+// For Adam7 images every pass row is scattered straight into the final image, so no per-pass image is ever built.
+// With a row converter, each unfiltered row is converted to the output layout before it is written.
+// With an image scaler, converted rows are reduced by the scaler (which owns the output) instead of being written.
+typedef struct _scanline_decoder
+{
+    IHDR_t ihdr;
+    image_view_t output;
+    const row_converter_t *converter; // nullptr when the output keeps the PNG sample layout
+    image_scaler_t *scaler;           // nullptr unless the output is a reduced-resolution image
+    region_t region;                  // Part of the image written to the output (output pixel (0, 0) is its corner)
+    size_t bpp;
+    bool in_place;                    // Rows are unfiltered directly into the output (whole non-interlaced image, no conversion)
+    size_t bytes_left;                // Bytes of the decompressed stream still needed, scanlines past the region are never pushed
+
+    int pass;             // Current Adam7 pass (always 0 for non-interlaced images)
+    uint32_t pass_width;  // Pixels per scanline of the current pass
+    uint32_t pass_height; // Scanlines in the current pass
+    uint32_t pass_row;    // Next scanline within the current pass
+    size_t pass_stride;   // Bytes per scanline of the current pass, without the filter type byte
+    bool finished;
+
+    // Unfiltered current and previous scanline, when rows cannot be unfiltered in place in the output
+    byte_buffer_t rows[2];
+    const uint8_t *previous_row; // nullptr at the start of the image / of every pass
+    byte_buffer_t aligned_row;   // Packed pixels of the region shifted to a byte boundary, before they are converted
+    byte_buffer_t converted_row; // Converted pass scanline of an interlaced or scaled image, before it is scattered / scaled
+
+    decode_stats_t *stats = nullptr; // Unfilter and convert stages are timed into it when the decoder collects stats
+} scanline_decoder_t;
+
+// Clip a requested region to the image, a zero width or height extends to the edge. Fails if it is outside the image.
+bool resolve_region(const IHDR_t &ihdr, const region_t &requested, region_t &region);
+
+// Prepare to decode the scanlines of an image into `output` (region-sized, the whole image without a region).
+// Pixels keep the PNG sample layout unless a converter is given; it must outlive the decoding.
+// With a scaler (prepared with begin_scaling for the region size), `output` is ignored and the region is reduced into the scaler's output.
+bool begin_scanlines(scanline_decoder_t &decoder, const IHDR_t &ihdr, const image_view_t &output, const row_converter_t *converter = nullptr, const region_t *region = nullptr,
+                     image_scaler_t *scaler = nullptr);
+
+// Size of the next scanline to push, including its filter type byte (0 once every scanline the output needs has been decoded)
+size_t next_scanline_size(const scanline_decoder_t &decoder);
+
+// Unfilter the next scanline and write its pixels to the output image
+bool push_scanline(scanline_decoder_t &decoder, const uint8_t *filtered_row);
+
+// Push every remaining scanline from a buffer of consecutive filtered scanlines
+bool push_scanlines(scanline_decoder_t &decoder, const uint8_t *filtered, size_t filtered_size);
+
+// Move a decoder of a whole non-interlaced image to scanline `row`, as if the rows above had been pushed. Their pixels
+// are not known, so the scanline pushed next must not be predicted from the row above (filter type None or Sub).
+bool seek_scanline(scanline_decoder_t &decoder, uint32_t row);
+
+// Unfilter and convert a whole decompressed image, interlaced or not, into `output`.
+// With a region, `filtered` only needs to hold inflated_rows_size(ihdr, region->y + region->height) bytes.
+bool decode_scanlines(const uint8_t *filtered, size_t filtered_size, const IHDR_t &ihdr, const row_converter_t *converter, const image_view_t &output, const region_t *region = nullptr,
+                      image_scaler_t *scaler = nullptr);
+
+// Reverse the filters of a whole decompressed image, interlaced or not.
+// `pixels` receives height * stride bytes in PNG sample layout (big-endian 16-bit samples, packed sub-byte samples).
+bool unfilter_image(const uint8_t *filtered, size_t filtered_size, const IHDR_t &ihdr, byte_buffer_t &pixels);
+
+#endif // __SCANLINE_DECODER_H__
@@ -0,0 +1,64 @@
+#include "scratch_arena.h"
+#include <algorithm>
+
+static const size_t SCRATCH_ALIGNMENT = 16;
+
+// Smallest block, enough for a stream-read metadata chunk and the zlib state of a compressed text chunk
+static const size_t MIN_SCRATCH_SIZE = 64 << 10;
+
+static size_t align_size(size_t size)
+{
+    return (size + SCRATCH_ALIGNMENT - 1) & ~(SCRATCH_ALIGNMENT - 1);
+}
+
+void *scratch_alloc(scratch_arena_t &arena, size_t size)
+{
+    size = align_size(std::max<size_t>(size, 1));
+    arena.stats.allocations++;
+    arena.stats.bytes += size;
+    arena.stats.peak_bytes = std::max(arena.stats.peak_bytes, arena.used + arena.overflow_bytes + size);
+
+    if (arena.used + size <= arena.block.size())
+    {
+        void *p = arena.block.data() + arena.used;
+        arena.used += size;
+        return p;
+    }
+
+    // Does not fit: serve it from the heap this time, the block grows on the next reset
+    arena.stats.heap_allocations++;
+    arena.stats.heap_bytes += size;
+    arena.overflow.emplace_back(size);
+    arena.overflow_bytes += size;
+    return arena.overflow.back().data();
+}
+
+void reset_scratch(scratch_arena_t &arena)
+{
+    if (!arena.overflow.empty())
+    {
+        const size_t size = std::max(align_size(arena.used + arena.overflow_bytes), MIN_SCRATCH_SIZE);
+        arena.overflow.clear();
+        arena.overflow_bytes = 0;
+        arena.block.clear();
+        arena.block.shrink_to_fit();
+        arena.block.resize(size);
+        arena.stats.heap_allocations++;
+        arena.stats.heap_bytes += size;
+    }
+    arena.used = 0;
+}
+
+void reset_scratch_stats(scratch_arena_t &arena)
+{
+    arena.stats = {};
+}
+
+void *scratch_zalloc(void *opaque, unsigned items, unsigned size)
+{
+    return scratch_alloc(*static_cast<scratch_arena_t *>(opaque), static_cast<size_t>(items) * size);
+}
+
+void scratch_zfree(void *, void *)
+{
+}
@@ -0,0 +1,44 @@
+#ifndef __SCRATCH_ARENA_H__
+#define __SCRATCH_ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_buffer.h"
+
+// Allocation counters of a scratch arena, cumulative until reset_scratch_stats
+typedef struct _scratch_stats
+{
+    size_t allocations = 0;      // Scratch allocations served
+    size_t bytes = 0;            // Bytes handed out
+    size_t heap_allocations = 0; // Heap allocations the arena made (0 per chunk once it has grown to its working size)
+    size_t heap_bytes = 0;
+    size_t peak_bytes = 0; // Largest scratch footprint of a single chunk
+} scratch_stats_t;
+
+// Bump allocator for memory that only lives while one chunk is parsed (chunk data read from a stream, zlib state
+// for compressed text). The decoder resets it before every chunk: allocations are never freed one by one, and the
+// memory is kept, so once the arena has grown to the largest chunk it serves every chunk without touching the heap.
+typedef struct _scratch_arena
+{
+    byte_buffer_t block; // Reused from chunk to chunk
+    size_t used = 0;
+    std::vector<byte_buffer_t> overflow; // Allocations that did not fit in the block, merged into it on the next reset
+    size_t overflow_bytes = 0;
+    scratch_stats_t stats;
+} scratch_arena_t;
+
+// Allocate `size` bytes aligned on 16 bytes, valid until the next reset
+void *scratch_alloc(scratch_arena_t &arena, size_t size);
+
+// Release every allocation, growing the block to fit all of them at once if some overflowed
+void reset_scratch(scratch_arena_t &arena);
+
+void reset_scratch_stats(scratch_arena_t &arena);
+
+// zlib allocation callbacks drawing from the arena passed as `opaque` (freeing is left to reset_scratch)
+void *scratch_zalloc(void *opaque, unsigned items, unsigned size);
+void scratch_zfree(void *opaque, void *address);
+
+#endif // __SCRATCH_ARENA_H__
@@ -0,0 +1,98 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+work_stealing_pool_t::work_stealing_pool_t(size_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < thread_count; i++)
+        queues.push_back(std::make_unique<task_queue_t>());
+    for (size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(&work_stealing_pool_t::worker_loop, this, i);
+}
+
+work_stealing_pool_t::~work_stealing_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void work_stealing_pool_t::submit(task_t task)
+{
+    size_t index = next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    pending_tasks.fetch_add(1);
+    queued_tasks.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    // Take the state lock so a worker that just found every deque empty cannot miss this wake-up
+    std::lock_guard<std::mutex> lock(state_mutex);
+    work_available.notify_one();
+}
+
+void work_stealing_pool_t::wait()
+{
+    std::unique_lock<std::mutex> lock(state_mutex);
+    all_done.wait(lock, [this] { return pending_tasks.load() == 0; });
+}
+
+bool work_stealing_pool_t::pop_task(size_t worker_index, task_t &task)
+{
+    // Own deque first, newest task first
+    {
+        task_queue_t &own = *queues[worker_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Then steal the oldest task of the other workers
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        task_queue_t &victim = *queues[(worker_index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_pool_t::worker_loop(size_t worker_index)
+{
+    while (true)
+    {
+        task_t task;
+        if (pop_task(worker_index, task))
+        {
+            queued_tasks.fetch_sub(1);
+            task(worker_index);
+            if (pending_tasks.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(state_mutex);
+        work_available.wait(lock, [this] { return stopping || queued_tasks.load() > 0; });
+        if (stopping && queued_tasks.load() == 0)
+            return;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool where every worker owns a task deque: a worker pops its own tasks from the back (LIFO, cache-warm)
+// and, once it runs dry, steals from the front of the other workers' deques, so uneven task costs still balance out.
+class work_stealing_pool_t
+{
+  public:
+    // A task receives the index of the worker running it, so callers can keep per-worker state
+    typedef std::function<void(size_t worker_index)> task_t;
+
+    // 0 threads means one per hardware thread
+    explicit work_stealing_pool_t(size_t thread_count = 0);
+    work_stealing_pool_t(const work_stealing_pool_t &) = delete;
+    work_stealing_pool_t &operator=(const work_stealing_pool_t &) = delete;
+    ~work_stealing_pool_t();
+
+    size_t size() const
+    {
+        return threads.size();
+    }
+
+    // Queue a task on the next worker in round-robin order
+    void submit(task_t task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+  private:
+    struct task_queue_t
+    {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    bool pop_task(size_t worker_index, task_t &task);
+    void worker_loop(size_t worker_index);
+
+    std::vector<std::unique_ptr<task_queue_t>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    std::atomic<size_t> queued_tasks{0};  // Submitted but not yet picked up
+    std::atomic<size_t> pending_tasks{0}; // Submitted but not yet finished
+    std::atomic<size_t> next_queue{0};
+    bool stopping = false;
+};
+
+#endif // __THREAD_POOL_H__
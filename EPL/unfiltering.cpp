@@ -0,0 +1,409 @@
+#include "unfiltering.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+const adam7_pass_t ADAM7_PASSES[7] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+
+uint32_t adam7_pass_width(uint32_t width, int pass)
+{
+    const adam7_pass_t &p = ADAM7_PASSES[pass];
+    return width > p.x0 ? (width - p.x0 + p.dx - 1) / p.dx : 0;
+}
+
+uint32_t adam7_pass_height(uint32_t height, int pass)
+{
+    const adam7_pass_t &p = ADAM7_PASSES[pass];
+    return height > p.y0 ? (height - p.y0 + p.dy - 1) / p.dy : 0;
+}
+
+size_t bytes_per_pixel(const IHDR_t &ihdr)
+{
+    // Sub-byte pixels still use a filter distance of one byte
+    size_t bits = static_cast<size_t>(ihdr.channels) * ihdr.bit_depth;
+    return bits < 8 ? 1 : bits / 8;
+}
+
+size_t scanline_stride(const IHDR_t &ihdr, uint32_t width)
+{
+    return (static_cast<size_t>(width) * ihdr.channels * ihdr.bit_depth + 7) / 8;
+}
+
+size_t inflated_image_size(const IHDR_t &ihdr)
+{
+    return inflated_rows_size(ihdr, ihdr.height);
+}
+
+size_t inflated_rows_size(const IHDR_t &ihdr, uint32_t row_count)
+{
+    size_t size = 0;
+    return inflated_rows_size_within(ihdr, row_count, SIZE_MAX, size) ? size : SIZE_MAX;
+}
+
+bool inflated_rows_size_within(const IHDR_t &ihdr, uint32_t row_count, size_t max_size, size_t &size)
+{
+    // Every product is checked against what is left of max_size before it is taken, IHDR sizes can wrap 64 bits around
+    size = 0;
+    row_count = std::min(row_count, ihdr.height);
+    if (ihdr.interlace_method == 0)
+    {
+        const size_t row_size = scanline_stride(ihdr, ihdr.width) + 1;
+        if (row_count != 0 && row_size > max_size / row_count)
+            return false;
+        size = row_size * row_count;
+        return true;
+    }
+
+    // Passes are stored one after the other: every pass before the last one holding a needed row is needed in full
+    size_t total = 0;
+    bool beyond = false; // The passes so far already exceed max_size
+    for (int pass = 0; pass < 7; pass++)
+    {
+        uint32_t pass_width = adam7_pass_width(ihdr.width, pass);
+        uint32_t pass_height = adam7_pass_height(ihdr.height, pass);
+        // Empty passes have no scanlines at all, not even filter type bytes
+        if (pass_width == 0 || pass_height == 0)
+            continue;
+        const size_t row_size = scanline_stride(ihdr, pass_width) + 1;
+        const uint32_t needed_rows = adam7_pass_height(row_count, pass); // Pass rows above row_count
+        if (needed_rows > 0)
+        {
+            if (beyond || row_size > (max_size - total) / needed_rows)
+                return false;
+            size = total + row_size * needed_rows;
+        }
+        if (beyond || row_size > (max_size - total) / pass_height)
+            beyond = true;
+        else
+            total += row_size * pass_height;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scalar kernels, used for 1 and 2 bytes per pixel and on non-x86 targets
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void unfilter_sub_scalar(uint8_t *out, const uint8_t *in, size_t stride, size_t bpp)
+{
+    for (size_t i = 0; i < bpp && i < stride; i++)
+        out[i] = in[i];
+    for (size_t i = bpp; i < stride; i++)
+        out[i] = in[i] + out[i - bpp];
+}
+
+static void unfilter_up_scalar(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+    for (size_t i = 0; i < stride; i++)
+        out[i] = in[i] + prev[i];
+}
+
+static void unfilter_average_scalar(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp)
+{
+    if (prev == nullptr)
+    {
+        // First scanline: the byte above is zero, so only half of the left neighbour is predicted
+        for (size_t i = 0; i < bpp && i < stride; i++)
+            out[i] = in[i];
+        for (size_t i = bpp; i < stride; i++)
+            out[i] = in[i] + (out[i - bpp] >> 1);
+        return;
+    }
+    for (size_t i = 0; i < bpp && i < stride; i++)
+        out[i] = in[i] + (prev[i] >> 1);
+    for (size_t i = bpp; i < stride; i++)
+        out[i] = in[i] + ((out[i - bpp] + prev[i]) >> 1);
+}
+
+static inline uint8_t paeth_predictor(int a, int b, int c)
+{
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+    if (pb <= pc)
+        return static_cast<uint8_t>(b);
+    return static_cast<uint8_t>(c);
+}
+
+static void unfilter_paeth_scalar(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp)
+{
+    // Left and upper-left neighbours are zero for the first pixel, so the predictor is the byte above
+    for (size_t i = 0; i < bpp && i < stride; i++)
+        out[i] = in[i] + prev[i];
+    for (size_t i = bpp; i < stride; i++)
+        out[i] = in[i] + paeth_predictor(out[i - bpp], prev[i], prev[i - bpp]);
+}
+
+#if defined(EPL_HAVE_SSE2)
+// ---------------------------------------------------------------------------------------------------------------------
+// SSE2 kernels for 3, 4, 6 and 8 bytes per pixel (8/16-bit RGB and RGBA, 16-bit gray+alpha)
+// Sub, Average and Paeth depend on the reconstructed left pixel, so they walk the scanline one pixel at a time
+// with all channels of the pixel processed in parallel; Sub additionally uses a prefix sum for 4 and 8 bytes per pixel.
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <size_t BPP>
+static inline __m128i load_pixel(const uint8_t *p)
+{
+    if constexpr (BPP == 4)
+    {
+        int32_t v;
+        std::memcpy(&v, p, 4);
+        return _mm_cvtsi32_si128(v);
+    }
+    else if constexpr (BPP == 8)
+    {
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    }
+    else
+    {
+        uint64_t v = 0;
+        std::memcpy(&v, p, BPP);
+        return _mm_cvtsi64_si128(static_cast<long long>(v));
+    }
+}
+
+template <size_t BPP>
+static inline void store_pixel(uint8_t *p, __m128i v)
+{
+    if constexpr (BPP == 4)
+    {
+        int32_t s = _mm_cvtsi128_si32(v);
+        std::memcpy(p, &s, 4);
+    }
+    else if constexpr (BPP == 8)
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(p), v);
+    }
+    else
+    {
+        uint64_t s = static_cast<uint64_t>(_mm_cvtsi128_si64(v));
+        std::memcpy(p, &s, BPP);
+    }
+}
+
+template <size_t BPP>
+static void unfilter_sub_sse2(uint8_t *out, const uint8_t *in, size_t stride)
+{
+    __m128i a = _mm_setzero_si128();
+    size_t i = 0;
+    if constexpr (BPP == 4 || BPP == 8)
+    {
+        // Prefix sum of the pixels in a 16-byte block, plus the last reconstructed pixel broadcast to every lane
+        for (; i + 16 <= stride; i += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, BPP));
+            if constexpr (BPP == 4)
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, a);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+            if constexpr (BPP == 4)
+                a = _mm_shuffle_epi32(x, 0xFF);
+            else
+                a = _mm_unpackhi_epi64(x, x);
+        }
+    }
+    for (; i + BPP <= stride; i += BPP)
+    {
+        a = _mm_add_epi8(a, load_pixel<BPP>(in + i));
+        store_pixel<BPP>(out + i, a);
+    }
+}
+
+template <size_t BPP>
+static void unfilter_average_sse2(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+    // _mm_avg_epu8 rounds up, so subtract the carried-in low bit to get floor((a + b) / 2)
+    const __m128i ones = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + BPP <= stride; i += BPP)
+    {
+        __m128i b = prev ? load_pixel<BPP>(prev + i) : _mm_setzero_si128();
+        __m128i avg = _mm_avg_epu8(a, b);
+        avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), ones));
+        a = _mm_add_epi8(load_pixel<BPP>(in + i), avg);
+        store_pixel<BPP>(out + i, a);
+    }
+}
+
+static inline __m128i abs_epi16(__m128i x)
+{
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i select_epi16(__m128i mask, __m128i if_true, __m128i if_false)
+{
+    return _mm_or_si128(_mm_and_si128(mask, if_true), _mm_andnot_si128(mask, if_false));
+}
+
+template <size_t BPP>
+static void unfilter_paeth_sse2(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+    // Work in 16-bit lanes so that a + b - c cannot overflow; a pixel of up to 8 bytes fits in one register
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero;
+    __m128i c = zero;
+    for (size_t i = 0; i + BPP <= stride; i += BPP)
+    {
+        __m128i b = _mm_unpacklo_epi8(load_pixel<BPP>(prev + i), zero);
+        __m128i d = _mm_unpacklo_epi8(load_pixel<BPP>(in + i), zero);
+
+        __m128i pa = _mm_sub_epi16(b, c); // p - a
+        __m128i pb = _mm_sub_epi16(a, c); // p - b
+        __m128i pc = _mm_add_epi16(pa, pb);
+        pa = abs_epi16(pa);
+        pb = abs_epi16(pb);
+        pc = abs_epi16(pc);
+
+        // Ties are broken in the order a, b, c as required by the specification
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        __m128i nearest = select_epi16(_mm_cmpeq_epi16(smallest, pa), a, select_epi16(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+        // Byte-wise add keeps the sum modulo 256 in the low byte of every lane
+        a = _mm_add_epi8(d, nearest);
+        store_pixel<BPP>(out + i, _mm_packus_epi16(a, a));
+        c = b;
+    }
+}
+
+static void unfilter_up_sse2(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+    size_t i = 0;
+    for (; i + 16 <= stride; i += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_add_epi8(x, b));
+    }
+    unfilter_up_scalar(out + i, in + i, prev + i, stride - i);
+}
+#endif // EPL_HAVE_SSE2
+
+#if defined(EPL_HAVE_AVX2)
+EPL_TARGET_AVX2 static void unfilter_up_avx2(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+    size_t i = 0;
+    for (; i + 32 <= stride; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_add_epi8(x, b));
+    }
+    unfilter_up_sse2(out + i, in + i, prev + i, stride - i);
+}
+#endif // EPL_HAVE_AVX2
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void unfilter_up(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride)
+{
+#if defined(EPL_HAVE_AVX2)
+    if (cpu_has_avx2())
+        return unfilter_up_avx2(out, in, prev, stride);
+#endif
+#if defined(EPL_HAVE_SSE2)
+    unfilter_up_sse2(out, in, prev, stride);
+#else
+    unfilter_up_scalar(out, in, prev, stride);
+#endif
+}
+
+static void unfilter_sub(uint8_t *out, const uint8_t *in, size_t stride, size_t bpp)
+{
+#if defined(EPL_HAVE_SSE2)
+    switch (bpp)
+    {
+    case 3:
+        return unfilter_sub_sse2<3>(out, in, stride);
+    case 4:
+        return unfilter_sub_sse2<4>(out, in, stride);
+    case 6:
+        return unfilter_sub_sse2<6>(out, in, stride);
+    case 8:
+        return unfilter_sub_sse2<8>(out, in, stride);
+    }
+#endif
+    unfilter_sub_scalar(out, in, stride, bpp);
+}
+
+static void unfilter_average(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp)
+{
+#if defined(EPL_HAVE_SSE2)
+    switch (bpp)
+    {
+    case 3:
+        return unfilter_average_sse2<3>(out, in, prev, stride);
+    case 4:
+        return unfilter_average_sse2<4>(out, in, prev, stride);
+    case 6:
+        return unfilter_average_sse2<6>(out, in, prev, stride);
+    case 8:
+        return unfilter_average_sse2<8>(out, in, prev, stride);
+    }
+#endif
+    unfilter_average_scalar(out, in, prev, stride, bpp);
+}
+
+static void unfilter_paeth(uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp)
+{
+#if defined(EPL_HAVE_SSE2)
+    switch (bpp)
+    {
+    case 3:
+        return unfilter_paeth_sse2<3>(out, in, prev, stride);
+    case 4:
+        return unfilter_paeth_sse2<4>(out, in, prev, stride);
+    case 6:
+        return unfilter_paeth_sse2<6>(out, in, prev, stride);
+    case 8:
+        return unfilter_paeth_sse2<8>(out, in, prev, stride);
+    }
+#endif
+    unfilter_paeth_scalar(out, in, prev, stride, bpp);
+}
+
+bool unfilter_scanline(uint8_t filter_type, uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp)
+{
+    switch (filter_type)
+    {
+    case FILTER_NONE:
+        if (out != in)
+            std::memcpy(out, in, stride);
+        return true;
+    case FILTER_SUB:
+        unfilter_sub(out, in, stride, bpp);
+        return true;
+    case FILTER_UP:
+        // With no previous scanline, Up degenerates to None
+        if (prev == nullptr)
+        {
+            if (out != in)
+                std::memcpy(out, in, stride);
+        }
+        else
+            unfilter_up(out, in, prev, stride);
+        return true;
+    case FILTER_AVERAGE:
+        unfilter_average(out, in, prev, stride, bpp);
+        return true;
+    case FILTER_PAETH:
+        // With no previous scanline, Paeth always predicts the left neighbour, i.e. Sub
+        if (prev == nullptr)
+            unfilter_sub(out, in, stride, bpp);
+        else
+            unfilter_paeth(out, in, prev, stride, bpp);
+        return true;
+    default:
+        std::cerr << "Error: Invalid filter type " << static_cast<int>(filter_type) << "!" << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef __UNFILTERING_H__
+#define __UNFILTERING_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "png_properties.h"
+
+// PNG filter types (filter method 0), stored as the first byte of every scanline
+enum png_filter_type_t : uint8_t
+{
+    FILTER_NONE = 0,
+    FILTER_SUB = 1,
+    FILTER_UP = 2,
+    FILTER_AVERAGE = 3,
+    FILTER_PAETH = 4,
+};
+
+// Adam7 pass geometry: first column/row and column/row increments of each of the 7 passes
+typedef struct _adam7_pass
+{
+    uint8_t x0;
+    uint8_t y0;
+    uint8_t dx;
+    uint8_t dy;
+} adam7_pass_t;
+
+extern const adam7_pass_t ADAM7_PASSES[7];
+
+// Width and height of the reduced image of an Adam7 pass (may be 0, in which case the pass is empty)
+uint32_t adam7_pass_width(uint32_t width, int pass);
+uint32_t adam7_pass_height(uint32_t height, int pass);
+
+// Number of bytes per complete pixel, rounded up to one byte (the "bpp" distance used by the filters)
+size_t bytes_per_pixel(const IHDR_t &ihdr);
+
+// Number of bytes in one scanline of `width` pixels, without the leading filter type byte
+size_t scanline_stride(const IHDR_t &ihdr, uint32_t width);
+
+// Exact size of the decompressed IDAT stream: every scanline (of every non-empty Adam7 pass) plus its filter type byte
+size_t inflated_image_size(const IHDR_t &ihdr);
+
+// Size of the start of the decompressed stream that holds every scanline needed to reconstruct rows [0, row_count):
+// the rows of a non-interlaced image, or all passes up to the last one that still has a row above row_count.
+// Sizes that do not fit in a size_t saturate to SIZE_MAX.
+size_t inflated_rows_size(const IHDR_t &ihdr, uint32_t row_count);
+
+// Checked inflated_rows_size: false when the size is larger than `max_size` (IHDR allows sizes far beyond any memory)
+bool inflated_rows_size_within(const IHDR_t &ihdr, uint32_t row_count, size_t max_size, size_t &size);
+
+// Reverse the filter of a single scanline.
+// `in` points to the filtered bytes (after the filter type byte), `out` receives the reconstructed bytes and may alias `in`.
+// `prev` is the previous reconstructed scanline, or nullptr for the first scanline of an image (or of an interlace pass).
+bool unfilter_scanline(uint8_t filter_type, uint8_t *out, const uint8_t *in, const uint8_t *prev, size_t stride, size_t bpp);
+
+#endif // __UNFILTERING_H__
@@ -0,0 +1,309 @@
+#include "corpus.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <zlib.h>
+
+// Color type and bit depth of every format a PNG can have
+typedef struct _corpus_format
+{
+    uint8_t color_type;
+    uint8_t bit_depth;
+    const char *name;
+} corpus_format_t;
+
+static const corpus_format_t CORPUS_FORMATS[] = {
+    {0, 1, "gray1"},    {0, 2, "gray2"}, {0, 4, "gray4"}, {0, 8, "gray8"}, {0, 16, "gray16"}, {2, 8, "rgb8"},     {2, 16, "rgb16"},   {3, 1, "palette1"},
+    {3, 2, "palette2"}, {3, 4, "palette4"}, {3, 8, "palette8"}, {4, 8, "graya8"}, {4, 16, "graya16"}, {6, 8, "rgba8"}, {6, 16, "rgba16"},
+};
+
+static const uint32_t SIZE_CLASS_DIMENSIONS[SIZE_CLASS_COUNT][2] = {{16, 16}, {160, 120}, {1024, 768}, {2560, 1440}};
+
+// Adam7 pass origins and steps
+static const uint8_t ADAM7[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+
+const char *filter_mix_name(filter_mix_t mix)
+{
+    static const char *const NAMES[FILTER_MIX_COUNT] = {"none", "sub", "up", "average", "paeth", "cycle", "adaptive"};
+    return mix < FILTER_MIX_COUNT ? NAMES[mix] : "unknown";
+}
+
+const char *idat_chunking_name(idat_chunking_t chunking)
+{
+    static const char *const NAMES[IDAT_CHUNKING_COUNT] = {"single", "idat8k", "idat64k", "idat_small"};
+    return chunking < IDAT_CHUNKING_COUNT ? NAMES[chunking] : "unknown";
+}
+
+const char *size_class_name(size_class_t size_class)
+{
+    static const char *const NAMES[SIZE_CLASS_COUNT] = {"icon", "thumbnail", "photo", "large"};
+    return size_class < SIZE_CLASS_COUNT ? NAMES[size_class] : "unknown";
+}
+
+// xorshift32, so the corpus only depends on the seed
+static uint32_t next_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void put_be32(std::vector<uint8_t> &out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void put_chunk(std::vector<uint8_t> &out, const char type[5], const uint8_t *data, size_t size)
+{
+    put_be32(out, static_cast<uint32_t>(size));
+    const size_t type_offset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, static_cast<uint32_t>(crc32(0, out.data() + type_offset, static_cast<uInt>(size + 4))));
+}
+
+// Sample of a smooth gradient with an inverted disc and some noise, like a rendered graphic or a denoised photo.
+// Full scale is 16 bits, reduced to the bit depth by the caller.
+static uint32_t sample_value(uint32_t x, uint32_t y, uint32_t c, uint32_t width, uint32_t height, uint32_t &random)
+{
+    const uint32_t gx = x * 255 / std::max(width - 1, 1u);
+    const uint32_t gy = y * 255 / std::max(height - 1, 1u);
+    int32_t value = static_cast<int32_t>((gx * (c + 1) + gy * 2) / (c + 3));
+
+    const int64_t dx = static_cast<int64_t>(x) - width / 2;
+    const int64_t dy = static_cast<int64_t>(y) - height / 2;
+    const int64_t radius = std::min(width, height) / 3;
+    if (dx * dx + dy * dy < radius * radius)
+        value = 255 - value;
+
+    value += static_cast<int32_t>(next_random(random) % 7) - 3;
+    value = std::clamp(value, 0, 255);
+    return static_cast<uint32_t>(value) << 8 | (next_random(random) & 0x0F);
+}
+
+// Pack one row of samples (already reduced to the bit depth) in PNG sample layout
+static void pack_row(const std::vector<uint32_t> &samples, uint8_t bit_depth, std::vector<uint8_t> &row)
+{
+    std::fill(row.begin(), row.end(), 0);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (bit_depth == 16)
+        {
+            row[2 * i] = static_cast<uint8_t>(samples[i] >> 8);
+            row[2 * i + 1] = static_cast<uint8_t>(samples[i]);
+        }
+        else if (bit_depth == 8)
+            row[i] = static_cast<uint8_t>(samples[i]);
+        else
+        {
+            const size_t bit = i * bit_depth;
+            row[bit / 8] |= static_cast<uint8_t>(samples[i] << (8 - bit_depth - bit % 8));
+        }
+    }
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// Filter a row with one filter type into `out` (filter type byte first)
+static void filter_row(uint8_t type, const std::vector<uint8_t> &row, const std::vector<uint8_t> *prev, size_t bpp, uint8_t *out)
+{
+    out[0] = type;
+    for (size_t i = 0; i < row.size(); i++)
+    {
+        const uint8_t a = i >= bpp ? row[i - bpp] : 0;
+        const uint8_t b = prev != nullptr ? (*prev)[i] : 0;
+        const uint8_t c = prev != nullptr && i >= bpp ? (*prev)[i - bpp] : 0;
+        uint8_t predictor = 0;
+        switch (type)
+        {
+        case 1:
+            predictor = a;
+            break;
+        case 2:
+            predictor = b;
+            break;
+        case 3:
+            predictor = static_cast<uint8_t>((a + b) / 2);
+            break;
+        case 4:
+            predictor = paeth(a, b, c);
+            break;
+        }
+        out[1 + i] = static_cast<uint8_t>(row[i] - predictor);
+    }
+}
+
+// Append a filtered row to the scanline stream, choosing the filter type as the mix asks
+static void append_filtered_row(filter_mix_t mix, size_t row_index, const std::vector<uint8_t> &row, const std::vector<uint8_t> *prev, size_t bpp, std::vector<uint8_t> &stream)
+{
+    const size_t offset = stream.size();
+    stream.resize(offset + row.size() + 1);
+    if (mix < FILTER_MIX_CYCLE)
+    {
+        filter_row(static_cast<uint8_t>(mix), row, prev, bpp, stream.data() + offset);
+        return;
+    }
+    if (mix == FILTER_MIX_CYCLE)
+    {
+        filter_row(static_cast<uint8_t>(row_index % 5), row, prev, bpp, stream.data() + offset);
+        return;
+    }
+
+    // Adaptive: smallest sum of the filtered bytes taken as signed values
+    std::vector<uint8_t> candidate(row.size() + 1);
+    uint64_t best_sum = UINT64_MAX;
+    for (uint8_t type = 0; type < 5; type++)
+    {
+        filter_row(type, row, prev, bpp, candidate.data());
+        uint64_t sum = 0;
+        for (size_t i = 1; i < candidate.size(); i++)
+            sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[i])));
+        if (sum < best_sum)
+        {
+            best_sum = sum;
+            std::copy(candidate.begin(), candidate.end(), stream.begin() + offset);
+        }
+    }
+}
+
+static std::vector<uint8_t> encode_image(const corpus_image_t &image, uint32_t seed)
+{
+    const uint32_t channels = image.color_type == 2 ? 3 : image.color_type == 4 ? 2 : image.color_type == 6 ? 4 : 1;
+    const uint32_t max_value = (1u << image.bit_depth) - 1;
+    const size_t bpp = std::max<size_t>(channels * image.bit_depth / 8, 1);
+    uint32_t random = seed * 2654435761u + 1;
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a};
+    std::vector<uint8_t> ihdr;
+    put_be32(ihdr, image.width);
+    put_be32(ihdr, image.height);
+    ihdr.insert(ihdr.end(), {image.bit_depth, image.color_type, 0, 0, image.interlace_method});
+    put_chunk(png, "IHDR", ihdr.data(), ihdr.size());
+
+    // Random palette, with transparency for every other size class so both RGB and RGBA expansion are covered
+    if (image.color_type == 3)
+    {
+        std::vector<uint8_t> palette(3 * (max_value + 1));
+        for (uint8_t &entry : palette)
+            entry = static_cast<uint8_t>(next_random(random));
+        put_chunk(png, "PLTE", palette.data(), palette.size());
+        if (image.size_class % 2 == 1)
+        {
+            std::vector<uint8_t> alpha((max_value + 1) / 2 + 1);
+            for (uint8_t &entry : alpha)
+                entry = static_cast<uint8_t>(next_random(random));
+            put_chunk(png, "tRNS", alpha.data(), alpha.size());
+        }
+    }
+
+    // Scanlines of the whole image or of every Adam7 pass, filtered as they are produced
+    std::vector<uint8_t> scanlines;
+    size_t row_index = 0;
+    for (int pass = 0; pass < (image.interlace_method == 1 ? 7 : 1); pass++)
+    {
+        const uint32_t x0 = image.interlace_method == 1 ? ADAM7[pass][0] : 0;
+        const uint32_t y0 = image.interlace_method == 1 ? ADAM7[pass][1] : 0;
+        const uint32_t dx = image.interlace_method == 1 ? ADAM7[pass][2] : 1;
+        const uint32_t dy = image.interlace_method == 1 ? ADAM7[pass][3] : 1;
+        const uint32_t pass_width = image.width > x0 ? (image.width - x0 + dx - 1) / dx : 0;
+        const uint32_t pass_height = image.height > y0 ? (image.height - y0 + dy - 1) / dy : 0;
+        if (pass_width == 0 || pass_height == 0)
+            continue;
+
+        std::vector<uint32_t> samples(static_cast<size_t>(pass_width) * channels);
+        std::vector<uint8_t> row((samples.size() * image.bit_depth + 7) / 8);
+        std::vector<uint8_t> prev;
+        for (uint32_t r = 0; r < pass_height; r++)
+        {
+            const uint32_t y = y0 + r * dy;
+            for (uint32_t i = 0; i < pass_width; i++)
+                for (uint32_t c = 0; c < channels; c++)
+                    samples[i * channels + c] = sample_value(x0 + i * dx, y, c, image.width, image.height, random) >> (16 - image.bit_depth);
+            pack_row(samples, image.bit_depth, row);
+            append_filtered_row(image.filter_mix, row_index++, row, r == 0 ? nullptr : &prev, bpp, scanlines);
+            prev = row;
+        }
+    }
+
+    uLongf compressed_size = compressBound(static_cast<uLong>(scanlines.size()));
+    std::vector<uint8_t> compressed(compressed_size);
+    compress2(compressed.data(), &compressed_size, scanlines.data(), static_cast<uLong>(scanlines.size()), 6);
+    compressed.resize(compressed_size);
+
+    for (size_t offset = 0; offset < compressed.size();)
+    {
+        size_t size = compressed.size() - offset;
+        if (image.chunking == IDAT_8K)
+            size = std::min<size_t>(size, 8192);
+        else if (image.chunking == IDAT_64K)
+            size = std::min<size_t>(size, 65536);
+        else if (image.chunking == IDAT_RANDOM_SMALL)
+            size = std::min<size_t>(size, 1 + next_random(random) % 512);
+        put_chunk(png, "IDAT", compressed.data() + offset, size);
+        offset += size;
+    }
+    put_chunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+std::vector<corpus_image_t> generate_corpus(const corpus_options_t &options)
+{
+    std::vector<corpus_image_t> corpus;
+    const size_t format_count = sizeof(CORPUS_FORMATS) / sizeof(CORPUS_FORMATS[0]);
+    for (size_t f = 0; f < format_count; f++)
+        for (uint8_t interlace = 0; interlace < 2; interlace++)
+            for (uint8_t s = 0; s < SIZE_CLASS_COUNT; s++)
+            {
+                if (s == SIZE_LARGE && !options.include_large)
+                    continue;
+
+                // For one format, the 8 interlace / size combinations go through all 7 filter mixes and 4 chunkings
+                corpus_image_t image;
+                image.color_type = CORPUS_FORMATS[f].color_type;
+                image.bit_depth = CORPUS_FORMATS[f].bit_depth;
+                image.interlace_method = interlace;
+                image.size_class = static_cast<size_class_t>(s);
+                image.filter_mix = static_cast<filter_mix_t>((interlace * 4 + s + f) % FILTER_MIX_COUNT);
+                image.chunking = static_cast<idat_chunking_t>((interlace + s + f) % IDAT_CHUNKING_COUNT);
+                image.width = SIZE_CLASS_DIMENSIONS[s][0];
+                image.height = SIZE_CLASS_DIMENSIONS[s][1];
+                image.name = std::string(CORPUS_FORMATS[f].name) + (interlace ? "_adam7_" : "_") + size_class_name(image.size_class) + "_" + filter_mix_name(image.filter_mix) +
+                             "_" + idat_chunking_name(image.chunking);
+                image.png = encode_image(image, options.seed + static_cast<uint32_t>(corpus.size()));
+                corpus.push_back(std::move(image));
+            }
+    return corpus;
+}
+
+bool write_corpus(const std::vector<corpus_image_t> &corpus, const std::string &directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    for (const corpus_image_t &image : corpus)
+    {
+        const std::string path = directory + "/" + image.name + ".png";
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(image.png.data()), image.png.size());
+        if (!file)
+        {
+            std::cerr << "Error writing " << path << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
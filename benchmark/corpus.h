@@ -0,0 +1,73 @@
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How the scanlines of a corpus image are filtered
+enum filter_mix_t : uint8_t
+{
+    FILTER_MIX_NONE,
+    FILTER_MIX_SUB,
+    FILTER_MIX_UP,
+    FILTER_MIX_AVERAGE,
+    FILTER_MIX_PAETH,
+    FILTER_MIX_CYCLE,    // Every filter type in turn, row after row
+    FILTER_MIX_ADAPTIVE, // Per row, the filter with the smallest sum of absolute differences (what libpng does)
+    FILTER_MIX_COUNT,
+};
+
+// How the zlib stream of a corpus image is split into IDAT chunks
+enum idat_chunking_t : uint8_t
+{
+    IDAT_SINGLE,       // One chunk
+    IDAT_8K,           // 8 KB chunks (libpng's default)
+    IDAT_64K,          // 64 KB chunks
+    IDAT_RANDOM_SMALL, // 1 to 512-byte chunks, the worst case for per-chunk overhead
+    IDAT_CHUNKING_COUNT,
+};
+
+enum size_class_t : uint8_t
+{
+    SIZE_ICON,      // 16x16
+    SIZE_THUMBNAIL, // 160x120
+    SIZE_PHOTO,     // 1024x768
+    SIZE_LARGE,     // 2560x1440
+    SIZE_CLASS_COUNT,
+};
+
+// A synthetic PNG file and how it was made
+typedef struct _corpus_image
+{
+    std::string name; // e.g. "rgba16_adam7_photo_paeth_idat8k"
+    uint8_t color_type;
+    uint8_t bit_depth;
+    uint8_t interlace_method;
+    filter_mix_t filter_mix;
+    idat_chunking_t chunking;
+    size_class_t size_class;
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> png;
+} corpus_image_t;
+
+typedef struct _corpus_options
+{
+    uint32_t seed = 1;         // Same seed, same corpus
+    bool include_large = true; // The large size class is most of the corpus bytes
+} corpus_options_t;
+
+// Generate one image for every color type / bit depth, interlace mode and size class, with the filter mixes and IDAT
+// chunking patterns spread over them so that every value of each occurs for every color type
+std::vector<corpus_image_t> generate_corpus(const corpus_options_t &options = {});
+
+// Write every image of a corpus as <directory>/<name>.png
+bool write_corpus(const std::vector<corpus_image_t> &corpus, const std::string &directory);
+
+const char *filter_mix_name(filter_mix_t mix);
+const char *idat_chunking_name(idat_chunking_t chunking);
+const char *size_class_name(size_class_t size_class);
+
+#endif // __CORPUS_H__
@@ -0,0 +1,304 @@
+#include "chunk_crc.h"
+#include "corpus.h"
+#include "decoder_context.h"
+#include "inflate_backend.h"
+#include "pixel_conversion.h"
+#include "png_decoder.h"
+#include "png_source.h"
+#include "scanline_decoder.h"
+#include "unfiltering.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Decoding stages timed on their own, plus the whole decoder
+enum benchmark_stage_t : uint8_t
+{
+    STAGE_PARSE,    // Chunk walk and metadata parsing (IDAT payloads skipped)
+    STAGE_CRC,      // CRC-32 of every chunk
+    STAGE_INFLATE,  // zlib stream of the concatenated IDAT data, whole-buffer
+    STAGE_UNFILTER, // Scanline filters (and Adam7 scattering)
+    STAGE_CONVERT,  // Row conversion to the default output layout, images that need one
+    STAGE_DECODE,   // decode_png_memory end to end, with a reused decoder context
+    STAGE_COUNT,
+};
+
+static const char *const STAGE_NAMES[STAGE_COUNT] = {"parse", "crc", "inflate", "unfilter", "convert", "decode"};
+
+// Bytes each stage is measured against
+static const char *const STAGE_UNITS[STAGE_COUNT] = {"file", "chunk", "decompressed", "decompressed", "output", "output"};
+
+typedef struct _stage_result
+{
+    size_t images = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+} stage_result_t;
+
+typedef struct _benchmark_settings
+{
+    corpus_options_t corpus;
+    double target_megabytes = 8.0; // Bytes every stage processes per image, small images are repeated to get there
+    const inflate_backend_t *backend = nullptr;
+    std::string json_path;        // stdout when empty
+    std::string corpus_directory; // Also write the corpus there
+} benchmark_settings_t;
+
+// Everything the stages of one image work on, prepared untimed
+typedef struct _prepared_image
+{
+    png_properties_t properties;
+    std::vector<uint8_t> idat;
+    byte_buffer_t inflated;
+    byte_buffer_t unfiltered;
+    row_converter_t converter;
+} prepared_image_t;
+
+static void print_usage()
+{
+    std::cerr << "Usage:./png_benchmark [--json <file>] [--seed N] [--target-mb N] [--no-large] [--backend zlib|zlib-ng|libdeflate] [--write-corpus <directory>]" << std::endl;
+}
+
+static bool parse_arguments(int argc, char **argv, benchmark_settings_t &settings)
+{
+    settings.backend = find_inflate_backend(INFLATE_AUTO);
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--no-large") == 0)
+            settings.corpus.include_large = false;
+        else if (std::strcmp(argv[i], "--json") == 0 && has_value)
+            settings.json_path = argv[++i];
+        else if (std::strcmp(argv[i], "--seed") == 0 && has_value)
+            settings.corpus.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--target-mb") == 0 && has_value)
+            settings.target_megabytes = std::max(std::strtod(argv[++i], nullptr), 0.001);
+        else if (std::strcmp(argv[i], "--write-corpus") == 0 && has_value)
+            settings.corpus_directory = argv[++i];
+        else if (std::strcmp(argv[i], "--backend") == 0 && has_value)
+        {
+            const char *name = argv[++i];
+            settings.backend = nullptr;
+            for (const inflate_backend_t *backend : available_inflate_backends())
+                if (std::strcmp(backend->name, name) == 0)
+                    settings.backend = backend;
+            if (settings.backend == nullptr)
+            {
+                std::cerr << "Error: Inflate backend " << name << " is not built in!" << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            print_usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool prepare_image(const corpus_image_t &image, const inflate_backend_t *backend, prepared_image_t &prepared)
+{
+    if (!probe_png_memory(image.png, prepared.properties))
+        return false;
+
+    memory_source_t source(image.png.data(), image.png.size());
+    uint8_t signature[8];
+    png_chunk_t chunk;
+    source.read_signature(signature);
+    while (source.next_chunk(chunk))
+        if (std::memcmp(chunk.type, "IDAT", 4) == 0 && source.read_chunk_data(chunk))
+            prepared.idat.insert(prepared.idat.end(), chunk.buffer.begin(), chunk.buffer.end() - 4);
+
+    const IHDR_t &ihdr = prepared.properties.ihdr;
+    prepared.inflated.resize(inflated_image_size(ihdr));
+    if (!backend->inflate_buffer(prepared.idat.data(), prepared.idat.size(), prepared.inflated.data(), prepared.inflated.size(), false))
+        return false;
+    if (!unfilter_image(prepared.inflated.data(), prepared.inflated.size(), ihdr, prepared.unfiltered))
+        return false;
+    return setup_row_converter(prepared.converter, prepared.properties, decode_options_t());
+}
+
+// Run one stage `repeats` times and set the bytes it processed once (0 if it does not apply to the image).
+// Fails as soon as the stage fails: failed runs must not count as throughput.
+static bool run_stage(benchmark_stage_t stage, const corpus_image_t &image, prepared_image_t &prepared, decoder_context_t &context, const inflate_backend_t *backend,
+                      size_t repeats, byte_buffer_t &output, size_t &bytes)
+{
+    const IHDR_t &ihdr = prepared.properties.ihdr;
+    bytes = 0;
+    for (size_t r = 0; r < repeats; r++)
+    {
+        switch (stage)
+        {
+        case STAGE_PARSE:
+        {
+            png_properties_t properties;
+            probe_png_memory(image.png, properties);
+            bytes = image.png.size();
+            break;
+        }
+        case STAGE_CRC:
+        {
+            memory_source_t source(image.png.data(), image.png.size());
+            uint8_t signature[8];
+            png_chunk_t chunk;
+            source.read_signature(signature);
+            bytes = 0;
+            while (source.next_chunk(chunk) && source.read_chunk_data(chunk))
+            {
+                verify_chunk_crc(chunk);
+                bytes += chunk.length + 4;
+            }
+            break;
+        }
+        case STAGE_INFLATE:
+            output.resize(prepared.inflated.size());
+            if (!backend->inflate_buffer(prepared.idat.data(), prepared.idat.size(), output.data(), output.size(), false))
+                return false;
+            bytes = output.size();
+            break;
+        case STAGE_UNFILTER:
+            if (!unfilter_image(prepared.inflated.data(), prepared.inflated.size(), ihdr, output))
+                return false;
+            bytes = prepared.inflated.size();
+            break;
+        case STAGE_CONVERT:
+        {
+            const row_converter_t &converter = prepared.converter;
+            if (converter.convert == nullptr)
+                return true;
+            const size_t stride = scanline_stride(ihdr, ihdr.width);
+            output.resize(converter.layout.row_stride * ihdr.height);
+            for (uint32_t y = 0; y < ihdr.height; y++)
+                converter.convert(converter, prepared.unfiltered.data() + y * stride, ihdr.width, output.data() + y * converter.layout.row_stride);
+            bytes = output.size();
+            break;
+        }
+        case STAGE_DECODE:
+        {
+            decode_options_t options;
+            options.inflate_backend = backend->id;
+            if (!decode_png_memory(image.png, prepared.properties, context, options))
+                return false;
+            bytes = prepared.properties.pixels.size();
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+static void write_stage_json(std::ostream &os, const stage_result_t results[STAGE_COUNT], const char *indent)
+{
+    os << "{\n";
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const stage_result_t &result = results[stage];
+        const double seconds = result.seconds > 0.0 ? result.seconds : 1e-12;
+        os << indent << "  \"" << STAGE_NAMES[stage] << "\": {\"images\": " << result.images << ", \"bytes\": " << result.bytes << ", \"bytes_measured\": \"" << STAGE_UNITS[stage]
+           << "\", \"seconds\": " << result.seconds << ", \"mb_per_s\": " << result.bytes / seconds / 1e6 << ", \"images_per_s\": " << result.images / seconds << "}"
+           << (stage + 1 < STAGE_COUNT ? ",\n" : "\n");
+    }
+    os << indent << "}";
+}
+
+int main(int argc, char **argv)
+{
+    benchmark_settings_t settings;
+    if (!parse_arguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    const std::vector<corpus_image_t> corpus = generate_corpus(settings.corpus);
+    if (!settings.corpus_directory.empty() && !write_corpus(corpus, settings.corpus_directory))
+        return EXIT_FAILURE;
+
+    stage_result_t totals[STAGE_COUNT];
+    stage_result_t by_size_class[SIZE_CLASS_COUNT][STAGE_COUNT];
+    size_t corpus_bytes = 0;
+    decoder_context_t context;
+    byte_buffer_t output;
+    for (const corpus_image_t &image : corpus)
+    {
+        prepared_image_t prepared;
+        if (!prepare_image(image, settings.backend, prepared))
+        {
+            std::cerr << "Error: Corpus image " << image.name << " does not decode!" << std::endl;
+            return EXIT_FAILURE;
+        }
+        corpus_bytes += image.png.size();
+
+        // Small images are repeated until every stage has processed about the same amount of data
+        const size_t image_bytes = std::max<size_t>(prepared.inflated.size(), 1);
+        const size_t repeats = std::clamp<size_t>(static_cast<size_t>(settings.target_megabytes * 1e6 / image_bytes), 2, 1000000);
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            const benchmark_stage_t id = static_cast<benchmark_stage_t>(stage);
+            // Warm the caches and size the buffers first
+            size_t bytes;
+            bool ran = run_stage(id, image, prepared, context, settings.backend, 1, output, bytes);
+            if (ran && bytes == 0)
+                continue;
+
+            const auto start = std::chrono::steady_clock::now();
+            ran = ran && run_stage(id, image, prepared, context, settings.backend, repeats, output, bytes);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!ran)
+            {
+                std::cerr << "Error: Stage " << STAGE_NAMES[stage] << " fails on corpus image " << image.name << "!" << std::endl;
+                return EXIT_FAILURE;
+            }
+            for (stage_result_t *result : {&totals[stage], &by_size_class[image.size_class][stage]})
+            {
+                result->images += repeats;
+                result->bytes += bytes * repeats;
+                result->seconds += seconds;
+            }
+        }
+    }
+
+    std::ofstream json_file;
+    if (!settings.json_path.empty())
+    {
+        json_file.open(settings.json_path);
+        if (!json_file)
+        {
+            std::cerr << "Error writing " << settings.json_path << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream &json = settings.json_path.empty() ? std::cout : json_file;
+    json << "{\n"
+         << "  \"corpus\": {\"seed\": " << settings.corpus.seed << ", \"images\": " << corpus.size() << ", \"bytes\": " << corpus_bytes
+         << ", \"include_large\": " << (settings.corpus.include_large ? "true" : "false") << "},\n"
+         << "  \"inflate_backend\": \"" << settings.backend->name << "\",\n"
+         << "  \"target_mb\": " << settings.target_megabytes << ",\n"
+         << "  \"stages\": ";
+    write_stage_json(json, totals, "  ");
+    json << ",\n  \"size_classes\": {\n";
+    bool first = true;
+    for (int s = 0; s < SIZE_CLASS_COUNT; s++)
+    {
+        if (by_size_class[s][STAGE_DECODE].images == 0)
+            continue;
+        json << (first ? "" : ",\n") << "    \"" << size_class_name(static_cast<size_class_t>(s)) << "\": ";
+        write_stage_json(json, by_size_class[s], "    ");
+        first = false;
+    }
+    json << "\n  }\n}" << std::endl;
+
+    // Human-readable summary
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const double seconds = totals[stage].seconds > 0.0 ? totals[stage].seconds : 1e-12;
+        std::cerr << "\t" << STAGE_NAMES[stage] << ": " << totals[stage].bytes / seconds / 1e6 << " MB/s (" << STAGE_UNITS[stage] << "), " << totals[stage].images / seconds
+                  << " images/s\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,653 @@
+#include "corpus.h"
+#include "decoder_context.h"
+#include "png_decoder.h"
+#include "png_decoder_cv.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <opencv2/imgcodecs.hpp>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef EPL_COMPARE_WITH_LIBPNG
+#include <csetjmp>
+#include <png.h>
+#endif
+
+#ifdef EPL_COMPARE_WITH_STB_IMAGE
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb_image.h>
+#endif
+
+// One image of the comparison corpus, a file when it was loaded from (or written to) a directory
+typedef struct _compare_image
+{
+    std::string name;
+    std::string path; // Empty for an in-memory corpus, file decoders are skipped then
+    std::vector<uint8_t> png;
+    size_t output_bytes = 0; // Size of the reference decoder's output, what throughput is measured against
+} compare_image_t;
+
+// Pixels a decoder returned, in whatever layout it returns them
+typedef struct _decoded_image
+{
+    const uint8_t *data = nullptr;
+    size_t row_stride = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;  // 1 to 4, gray / gray + alpha / color / color + alpha
+    uint8_t bit_depth = 8;  // 8 or 16 (native-endian), sub-byte samples are expected scaled to 0-255
+    bool bgr = false;       // Color channels in BGR order
+} decoded_image_t;
+
+// Buffers a decoder keeps from one image to the next
+typedef struct _decoder_state
+{
+    png_properties_t properties;
+    cv::Mat mat;
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t *> rows;
+    void *stb_pixels = nullptr;
+} decoder_state_t;
+
+typedef struct _compare_decoder
+{
+    const char *name;
+    bool from_file;   // Decodes compare_image_t::path instead of the bytes in memory
+    bool same_layout; // Must also return the same channels and bit depth as this decoder (a drop-in cv::Mat)
+    bool (*decode)(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded);
+} compare_decoder_t;
+
+// What a decoder did in its own process, sent back through a pipe
+typedef struct _throughput_result
+{
+    size_t images = 0;
+    size_t bytes = 0;
+    size_t failures = 0;
+    double seconds = 0.0;
+    long baseline_rss_kb = 0; // Resident memory before the first decode (the corpus and the binary)
+    long peak_rss_kb = 0;
+} throughput_result_t;
+
+typedef struct _compare_result
+{
+    throughput_result_t throughput;
+    size_t compared = 0;
+    size_t mismatches = 0;
+    size_t failures = 0;
+    bool ran = false;
+} compare_result_t;
+
+typedef struct _compare_settings
+{
+    corpus_options_t corpus;
+    double target_megabytes = 8.0; // Output bytes each decoder produces per image, small images are repeated to get there
+    std::string directory;         // PNG files to compare instead of the synthetic corpus
+    std::string corpus_directory;  // Write the synthetic corpus there, which also enables the file decoders
+    std::string json_path;         // stdout when empty
+} compare_settings_t;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Decoders
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Sub-byte grayscale is scaled to 0-255 by every other decoder, the rest is the cv::Mat layout
+static decode_options_t epl_options()
+{
+    decode_options_t options;
+    options.scale_gray = true;
+    return options;
+}
+
+static void mat_view(const cv::Mat &mat, decoded_image_t &decoded)
+{
+    decoded = {mat.data, mat.step[0], static_cast<uint32_t>(mat.cols), static_cast<uint32_t>(mat.rows), static_cast<uint32_t>(mat.channels()),
+               static_cast<uint8_t>(mat.depth() == CV_16U ? 16 : 8), mat.channels() >= 3};
+}
+
+static bool decode_epl_memory(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    if (!decode_png_mat(image.png, state.mat, state.properties, epl_options()))
+        return false;
+    mat_view(state.mat, decoded);
+    return true;
+}
+
+static bool decode_epl_file(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    if (!decode_png_mat(image.path.c_str(), state.mat, state.properties, epl_options()))
+        return false;
+    mat_view(state.mat, decoded);
+    return true;
+}
+
+static bool decode_opencv_memory(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    const cv::Mat buffer(1, static_cast<int>(image.png.size()), CV_8U, const_cast<uint8_t *>(image.png.data()));
+    cv::imdecode(buffer, cv::IMREAD_UNCHANGED, &state.mat);
+    if (state.mat.empty())
+        return false;
+    mat_view(state.mat, decoded);
+    return true;
+}
+
+static bool decode_opencv_file(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    state.mat = cv::imread(image.path, cv::IMREAD_UNCHANGED);
+    if (state.mat.empty())
+        return false;
+    mat_view(state.mat, decoded);
+    return true;
+}
+
+#ifdef EPL_COMPARE_WITH_LIBPNG
+typedef struct _libpng_reader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+} libpng_reader_t;
+
+static void libpng_read(png_structp png, png_bytep out, png_size_t length)
+{
+    libpng_reader_t *reader = static_cast<libpng_reader_t *>(png_get_io_ptr(png));
+    if (reader->size - reader->offset < length)
+        png_error(png, "Truncated PNG data");
+    std::memcpy(out, reader->data + reader->offset, length);
+    reader->offset += length;
+}
+
+// libpng's classic API, with the transformations that give the same samples as this decoder:
+// palette expanded (tRNS becomes alpha), sub-byte grayscale scaled, 16-bit samples native-endian
+static bool decode_libpng(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png != nullptr ? png_create_info_struct(png) : nullptr;
+    if (info == nullptr)
+    {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_read_struct(&png, &info, nullptr);
+        return false;
+    }
+
+    libpng_reader_t reader = {image.png.data(), image.png.size(), 0};
+    png_set_read_fn(png, &reader, libpng_read);
+    png_read_info(png, info);
+
+    const png_byte color_type = png_get_color_type(png, info);
+    const png_byte bit_depth = png_get_bit_depth(png, info);
+    if (color_type == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_palette_to_rgb(png);
+        if (png_get_valid(png, info, PNG_INFO_tRNS))
+            png_set_tRNS_to_alpha(png);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+        png_set_expand_gray_1_2_4_to_8(png);
+    if (bit_depth == 16)
+        png_set_swap(png);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    const uint32_t width = png_get_image_width(png, info);
+    const uint32_t height = png_get_image_height(png, info);
+    const size_t row_stride = png_get_rowbytes(png, info);
+    state.pixels.resize(row_stride * height);
+    state.rows.resize(height);
+    for (uint32_t y = 0; y < height; y++)
+        state.rows[y] = state.pixels.data() + y * row_stride;
+    png_read_image(png, state.rows.data());
+    png_read_end(png, nullptr);
+
+    decoded = {state.pixels.data(), row_stride, width, height, png_get_channels(png, info), png_get_bit_depth(png, info), false};
+    png_destroy_read_struct(&png, &info, nullptr);
+    return true;
+}
+#endif
+
+#ifdef EPL_COMPARE_WITH_STB_IMAGE
+static bool decode_stb_image(const compare_image_t &image, decoder_state_t &state, decoded_image_t &decoded)
+{
+    stbi_image_free(state.stb_pixels);
+    const stbi_uc *data = image.png.data();
+    const int size = static_cast<int>(image.png.size());
+    const bool is_16bit = stbi_is_16_bit_from_memory(data, size) != 0;
+    int width, height, channels;
+    state.stb_pixels = is_16bit ? static_cast<void *>(stbi_load_16_from_memory(data, size, &width, &height, &channels, 0))
+                                : static_cast<void *>(stbi_load_from_memory(data, size, &width, &height, &channels, 0));
+    if (state.stb_pixels == nullptr)
+        return false;
+
+    const uint8_t bit_depth = is_16bit ? 16 : 8;
+    decoded = {static_cast<const uint8_t *>(state.stb_pixels), static_cast<size_t>(width) * channels * bit_depth / 8, static_cast<uint32_t>(width),
+               static_cast<uint32_t>(height), static_cast<uint32_t>(channels), bit_depth, false};
+    return true;
+}
+#endif
+
+// The first decoder is the reference every other one is compared against
+static const compare_decoder_t DECODERS[] = {
+    {"epl", false, false, decode_epl_memory},
+    {"opencv_imdecode", false, true, decode_opencv_memory},
+    {"epl_file", true, false, decode_epl_file},
+    {"opencv_imread", true, true, decode_opencv_file},
+#ifdef EPL_COMPARE_WITH_LIBPNG
+    {"libpng", false, false, decode_libpng},
+#endif
+#ifdef EPL_COMPARE_WITH_STB_IMAGE
+    {"stb_image", false, false, decode_stb_image},
+#endif
+};
+
+static const size_t DECODER_COUNT = sizeof(DECODERS) / sizeof(DECODERS[0]);
+
+// Throughput is reported relative to OpenCV reading from the same kind of input
+static size_t baseline_decoder(const compare_decoder_t &decoder)
+{
+    const char *name = decoder.from_file ? "opencv_imread" : "opencv_imdecode";
+    size_t d = 0;
+    while (std::strcmp(DECODERS[d].name, name) != 0)
+        d++;
+    return d;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Comparison
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Widen any decoded layout to native 16-bit RGBA (8-bit samples times 257, gray copied to every color channel, opaque
+// when there is no alpha), so that decoders returning different layouts of the same pixels compare equal
+static void to_rgba16(const decoded_image_t &decoded, std::vector<uint16_t> &rgba)
+{
+    rgba.resize(static_cast<size_t>(decoded.width) * decoded.height * 4);
+    const bool has_alpha = decoded.channels == 2 || decoded.channels == 4;
+    const uint32_t color_channels = decoded.channels >= 3 ? 3 : 1;
+    uint16_t *out = rgba.data();
+    for (uint32_t y = 0; y < decoded.height; y++)
+    {
+        const uint8_t *row = decoded.data + y * decoded.row_stride;
+        for (uint32_t x = 0; x < decoded.width; x++, out += 4)
+        {
+            uint16_t samples[4];
+            for (uint32_t c = 0; c < decoded.channels; c++)
+            {
+                const size_t index = static_cast<size_t>(x) * decoded.channels + c;
+                if (decoded.bit_depth == 16)
+                    std::memcpy(&samples[c], row + index * 2, 2);
+                else
+                    samples[c] = static_cast<uint16_t>(row[index] * 257);
+            }
+            for (uint32_t c = 0; c < 3; c++)
+                out[c] = samples[color_channels == 1 ? 0 : c];
+            if (decoded.bgr && color_channels == 3)
+                std::swap(out[0], out[2]);
+            out[3] = has_alpha ? samples[color_channels] : 0xFFFF;
+        }
+    }
+}
+
+// Compare a decoder's pixels with the reference ones, reporting the first difference
+static bool same_pixels(const compare_image_t &image, const compare_decoder_t &decoder, const decoded_image_t &reference, const std::vector<uint16_t> &reference_rgba,
+                        const decoded_image_t &decoded, std::vector<uint16_t> &rgba)
+{
+    if (decoded.width != reference.width || decoded.height != reference.height)
+    {
+        std::cerr << "Mismatch: " << decoder.name << " decodes " << image.name << " as " << decoded.width << "x" << decoded.height << " instead of " << reference.width << "x"
+                  << reference.height << "." << std::endl;
+        return false;
+    }
+    if (decoder.same_layout && (decoded.channels != reference.channels || decoded.bit_depth != reference.bit_depth))
+    {
+        std::cerr << "Mismatch: " << decoder.name << " decodes " << image.name << " to " << decoded.channels << " channels of " << static_cast<int>(decoded.bit_depth) << " bits instead of "
+                  << reference.channels << " channels of " << static_cast<int>(reference.bit_depth) << " bits." << std::endl;
+        return false;
+    }
+
+    to_rgba16(decoded, rgba);
+    const auto difference = std::mismatch(rgba.begin(), rgba.end(), reference_rgba.begin());
+    if (difference.first == rgba.end())
+        return true;
+
+    const size_t pixel = static_cast<size_t>(difference.first - rgba.begin()) / 4;
+    std::cerr << "Mismatch: " << decoder.name << " decodes " << image.name << " differently at pixel (" << pixel % reference.width << ", " << pixel / reference.width << ")." << std::endl;
+    return false;
+}
+
+// Decode every image with every decoder and compare the pixels with the reference decoder's
+static void compare_pixels(std::vector<compare_image_t> &images, compare_result_t results[DECODER_COUNT])
+{
+    decoder_state_t states[DECODER_COUNT];
+    std::vector<uint16_t> reference_rgba, rgba;
+    for (compare_image_t &image : images)
+    {
+        decoded_image_t reference;
+        if (!DECODERS[0].decode(image, states[0], reference))
+        {
+            std::cerr << "Error: " << image.name << " does not decode, it is left out." << std::endl;
+            results[0].failures++;
+            continue;
+        }
+        image.output_bytes = reference.row_stride * reference.height;
+        to_rgba16(reference, reference_rgba);
+        results[0].compared++;
+
+        for (size_t d = 1; d < DECODER_COUNT; d++)
+        {
+            const compare_decoder_t &decoder = DECODERS[d];
+            if (decoder.from_file && image.path.empty())
+                continue;
+            decoded_image_t decoded;
+            if (!decoder.decode(image, states[d], decoded))
+            {
+                std::cerr << "Mismatch: " << decoder.name << " fails to decode " << image.name << "." << std::endl;
+                results[d].failures++;
+                continue;
+            }
+            results[d].compared++;
+            if (!same_pixels(image, decoder, reference, reference_rgba, decoded, rgba))
+                results[d].mismatches++;
+        }
+    }
+#ifdef EPL_COMPARE_WITH_STB_IMAGE
+    for (decoder_state_t &state : states)
+        stbi_image_free(state.stb_pixels);
+#endif
+}
+
+// Decode the top half of every image a few times through one decoder context, gathering and streaming the IDAT data,
+// and compare it with the rows of a whole decode: a context must not carry the state of an image over to the next one.
+// Returns the number of region decodes that failed or differed.
+static size_t check_context_reuse(const std::vector<compare_image_t> &images)
+{
+    static const int REPEATS = 3;
+    decoder_context_t context;
+    png_properties_t properties, reference;
+    size_t failures = 0;
+    for (const compare_image_t &image : images)
+    {
+        decode_options_t options = epl_options();
+        if (!decode_png_memory(image.png, reference, options))
+            continue;
+        options.region.height = std::max(reference.ihdr.height / 2, 1u);
+        const size_t region_bytes = reference.layout.row_stride * options.region.height;
+
+        for (bool streaming : {false, true})
+        {
+            options.streaming_inflate = streaming;
+            for (int repeat = 0; repeat < REPEATS; repeat++)
+            {
+                if (decode_png_memory(image.png, properties, context, options) && properties.pixels.size() == region_bytes &&
+                    std::equal(properties.pixels.begin(), properties.pixels.end(), reference.pixels.begin()))
+                    continue;
+                std::cerr << "Mismatch: " << image.name << " decodes differently through a reused context (top half, " << (streaming ? "streaming" : "gathered")
+                          << " IDAT data, decode " << repeat + 1 << ")." << std::endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput and memory
+// ---------------------------------------------------------------------------------------------------------------------
+
+// A field of /proc/self/status, in kB (0 if it cannot be read)
+static long read_status_kb(const char *field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = std::strlen(field);
+    while (std::getline(status, line))
+        if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+            return std::strtol(line.c_str() + length + 1, nullptr, 10);
+    return 0;
+}
+
+// Decode the whole corpus with one decoder, small images repeated until each has produced about the same amount of output
+static void measure_throughput(const std::vector<compare_image_t> &images, const compare_decoder_t &decoder, double target_megabytes, throughput_result_t &result)
+{
+    // The peak resident size is inherited from the parent, bring it back down to what this process holds now
+    std::ofstream("/proc/self/clear_refs") << "5" << std::endl;
+    result.baseline_rss_kb = read_status_kb("VmRSS");
+
+    decoder_state_t state;
+    decoded_image_t decoded;
+    for (const compare_image_t &image : images)
+    {
+        if (image.output_bytes == 0 || (decoder.from_file && image.path.empty()))
+            continue;
+        // Warm the caches and size the buffers first
+        if (!decoder.decode(image, state, decoded))
+        {
+            result.failures++;
+            continue;
+        }
+
+        const size_t repeats = std::clamp<size_t>(static_cast<size_t>(target_megabytes * 1e6 / image.output_bytes), 1, 100000);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; r++)
+            decoder.decode(image, state, decoded);
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.images += repeats;
+        result.bytes += image.output_bytes * repeats;
+    }
+    result.peak_rss_kb = read_status_kb("VmHWM");
+}
+
+// Measure a decoder in a child process, so that its peak resident size is its own and not the largest one of all decoders
+static bool measure_in_child(const std::vector<compare_image_t> &images, const compare_decoder_t &decoder, double target_megabytes, throughput_result_t &result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        std::cerr << "Error: Cannot create a pipe!" << std::endl;
+        return false;
+    }
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "Error: Cannot fork a process for " << decoder.name << "!" << std::endl;
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        throughput_result_t child_result;
+        measure_throughput(images, decoder, target_megabytes, child_result);
+        const bool written = write(fds[1], &child_result, sizeof(child_result)) == static_cast<ssize_t>(sizeof(child_result));
+        _exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    const bool received = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        std::cerr << "Error: Measuring " << decoder.name << " failed!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Corpus and report
+// ---------------------------------------------------------------------------------------------------------------------
+
+static bool load_directory(const std::string &directory, std::vector<compare_image_t> &images)
+{
+    std::error_code error;
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+        if (entry.is_regular_file() && entry.path().extension() == ".png")
+            paths.push_back(entry.path());
+    if (error)
+    {
+        std::cerr << "Error reading directory " << directory << "." << std::endl;
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const std::filesystem::path &path : paths)
+    {
+        compare_image_t image;
+        image.name = path.stem().string();
+        image.path = path.string();
+        std::ifstream file(path, std::ios::binary);
+        image.png.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        images.push_back(std::move(image));
+    }
+    return true;
+}
+
+static void print_usage()
+{
+    std::cerr << "Usage:./png_compare [--json <file>] [--directory <directory of PNG files>] [--seed N] [--target-mb N] [--no-large] [--write-corpus <directory>]" << std::endl;
+}
+
+static bool parse_arguments(int argc, char **argv, compare_settings_t &settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--no-large") == 0)
+            settings.corpus.include_large = false;
+        else if (std::strcmp(argv[i], "--json") == 0 && has_value)
+            settings.json_path = argv[++i];
+        else if (std::strcmp(argv[i], "--directory") == 0 && has_value)
+            settings.directory = argv[++i];
+        else if (std::strcmp(argv[i], "--seed") == 0 && has_value)
+            settings.corpus.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--target-mb") == 0 && has_value)
+            settings.target_megabytes = std::max(std::strtod(argv[++i], nullptr), 0.001);
+        else if (std::strcmp(argv[i], "--write-corpus") == 0 && has_value)
+            settings.corpus_directory = argv[++i];
+        else
+        {
+            print_usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+static void write_json(std::ostream &json, const compare_settings_t &settings, const std::vector<compare_image_t> &images, const compare_result_t results[DECODER_COUNT])
+{
+    size_t corpus_bytes = 0;
+    for (const compare_image_t &image : images)
+        corpus_bytes += image.png.size();
+
+    json << "{\n  \"corpus\": {";
+    if (settings.directory.empty())
+        json << "\"seed\": " << settings.corpus.seed << ", \"include_large\": " << (settings.corpus.include_large ? "true" : "false") << ", ";
+    else
+        json << "\"directory\": \"" << settings.directory << "\", ";
+    json << "\"images\": " << images.size() << ", \"bytes\": " << corpus_bytes << "},\n"
+         << "  \"target_mb\": " << settings.target_megabytes << ",\n"
+         << "  \"reference\": \"" << DECODERS[0].name << "\",\n"
+         << "  \"decoders\": {\n";
+    bool first = true;
+    for (size_t d = 0; d < DECODER_COUNT; d++)
+    {
+        const compare_result_t &result = results[d];
+        if (!result.ran)
+            continue;
+        const throughput_result_t &throughput = result.throughput;
+        const double seconds = throughput.seconds > 0.0 ? throughput.seconds : 1e-12;
+        const compare_result_t &baseline = results[baseline_decoder(DECODERS[d])];
+        const double relative = baseline.ran && baseline.throughput.seconds > 0.0 ? baseline.throughput.seconds / seconds : 0.0;
+        json << (first ? "" : ",\n") << "    \"" << DECODERS[d].name << "\": {\"compared\": " << result.compared << ", \"mismatches\": " << result.mismatches
+             << ", \"failures\": " << result.failures << ", \"images\": " << throughput.images << ", \"bytes\": " << throughput.bytes << ", \"seconds\": " << throughput.seconds
+             << ", \"mb_per_s\": " << throughput.bytes / seconds / 1e6 << ", \"images_per_s\": " << throughput.images / seconds << ", \"relative_to_opencv\": " << relative
+             << ", \"baseline_rss_kb\": " << throughput.baseline_rss_kb << ", \"peak_rss_kb\": " << throughput.peak_rss_kb
+             << ", \"decode_rss_kb\": " << std::max(throughput.peak_rss_kb - throughput.baseline_rss_kb, 0L) << "}";
+        first = false;
+    }
+    json << "\n  }\n}" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    compare_settings_t settings;
+    if (!parse_arguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    std::vector<compare_image_t> images;
+    if (!settings.directory.empty())
+    {
+        if (!load_directory(settings.directory, images))
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        std::vector<corpus_image_t> corpus = generate_corpus(settings.corpus);
+        if (!settings.corpus_directory.empty() && !write_corpus(corpus, settings.corpus_directory))
+            return EXIT_FAILURE;
+        for (corpus_image_t &generated : corpus)
+        {
+            compare_image_t image;
+            image.name = generated.name;
+            if (!settings.corpus_directory.empty())
+                image.path = settings.corpus_directory + "/" + generated.name + ".png";
+            image.png = std::move(generated.png);
+            images.push_back(std::move(image));
+        }
+    }
+
+    compare_result_t results[DECODER_COUNT];
+    compare_pixels(images, results);
+    const size_t reuse_failures = check_context_reuse(images);
+    // Hand the memory of the comparison back to the system, or the children would decode into already resident pages
+    malloc_trim(0);
+    for (size_t d = 0; d < DECODER_COUNT; d++)
+    {
+        if (results[d].compared == 0)
+            continue;
+        results[d].ran = measure_in_child(images, DECODERS[d], settings.target_megabytes, results[d].throughput);
+    }
+
+    std::ofstream json_file;
+    if (!settings.json_path.empty())
+    {
+        json_file.open(settings.json_path);
+        if (!json_file)
+        {
+            std::cerr << "Error writing " << settings.json_path << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    write_json(settings.json_path.empty() ? std::cout : json_file, settings, images, results);
+
+    // Human-readable summary
+    bool identical = reuse_failures == 0;
+    if (reuse_failures != 0)
+        std::cerr << "\tReused decoder context: " << reuse_failures << " region decodes failed or differed\n";
+    for (size_t d = 0; d < DECODER_COUNT; d++)
+    {
+        const compare_result_t &result = results[d];
+        identical = identical && result.mismatches == 0 && result.failures == 0;
+        if (!result.ran)
+            continue;
+        const double seconds = result.throughput.seconds > 0.0 ? result.throughput.seconds : 1e-12;
+        std::cerr << "\t" << DECODERS[d].name << ": " << result.compared - result.mismatches << "/" << result.compared + result.failures << " identical, "
+                  << result.throughput.bytes / seconds / 1e6 << " MB/s, peak RSS " << result.throughput.peak_rss_kb / 1024.0 << " MB ("
+                  << std::max(result.throughput.peak_rss_kb - result.throughput.baseline_rss_kb, 0L) / 1024.0 << " MB decoding)\n";
+    }
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
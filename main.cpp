@@ -1,249 +1,106 @@
 #include "main.h"
 
-int main(int argc, char **argv)
+static void print_usage()
 {
-    // std::ifstream png_file("./PNG_transparency_demonstration_1.png", std::ios::binary);
-    if (argc < 2)
+    std::cerr << "Usage:./EfficientPngLoading [--verbose] <input_png_file | - (read from stdin)>\n"
+              << "      ./EfficientPngLoading --batch <directory | list_file | - (paths from stdin)> [--threads N]\n"
+              << "      ./EfficientPngLoading --probe <input_png_file>\n"
+              << "      ./EfficientPngLoading --inflate-bench" << std::endl;
+}
+
+// Decode many files concurrently and report the aggregate throughput
+static int run_batch(int argc, char **argv)
+{
+    if (argc < 3)
     {
-        std::cerr << "Usage:./EfficientPngLoading <input_png_file>" << std::endl;
+        print_usage();
         return EXIT_FAILURE;
     }
 
-    std::ifstream png_file(argv[1], std::ios::binary);
-    if (!png_file.is_open())
+    size_t thread_count = 0; // One worker per core
+    for (int i = 3; i + 1 < argc; i += 2)
     {
-        std::cerr << "Error opening PNG file." << std::endl;
-        return 1;
+        if (std::strcmp(argv[i], "--threads") == 0)
+            thread_count = std::strtoul(argv[i + 1], nullptr, 10);
     }
 
-    // Decode png image
-    png_properties_t img_properties;
+    std::vector<std::string> paths;
+    if (!collect_png_paths(argv[2], paths))
+        return EXIT_FAILURE;
 
-    if (!decode_png_file(png_file, img_properties))
+    batch_result_t result = decode_png_batch(paths, {}, thread_count);
+    std::cout << "Batch decoding:\n" << result << std::endl;
+    return result.images_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Print the metadata of a file without decoding its image data
+static int run_probe(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        print_usage();
         return EXIT_FAILURE;
+    }
 
+    png_properties_t properties;
+    if (!probe_png_file(argv[2], properties))
+        return EXIT_FAILURE;
+    for (const text_t &text : properties.text)
+        std::cout << text.keyword << ": " << text.text << "\n";
     return EXIT_SUCCESS;
 }
 
-bool decode_png_file(std::ifstream &stream, png_properties_t &properties)
+// Time every inflate backend built into this binary and report the fastest
+static int run_inflate_bench()
 {
+    for (const inflate_benchmark_t &result : benchmark_inflate_backends())
+        std::cout << result.backend->name << ": " << result.megabytes_per_second << " MB/s" << std::endl;
+    std::cout << "Fastest: " << find_inflate_backend(select_fastest_inflate_backend())->name << std::endl;
+    return EXIT_SUCCESS;
+}
 
-    std::vector<uint8_t> png_header(8);
-    stream.read(reinterpret_cast<char *>(png_header.data()), png_header.size());
-
-    // Check if the file is a PNG
-    if (png_header[0] != 0x89 || png_header[1] != 'P' || png_header[2] != 'N' || png_header[3] != 'G' || png_header[4] != 0x0d || png_header[5] != 0x0a || png_header[6] != 0x1a ||
-        png_header[7] != 0x0a)
+int main(int argc, char **argv)
+{
+    // std::ifstream png_file("./PNG_transparency_demonstration_1.png", std::ios::binary);
+    // --verbose logs every chunk parsed and prints the decode stats
+    bool verbose = false;
+    if (argc >= 2 && std::strcmp(argv[1], "--verbose") == 0)
+    {
+        verbose = true;
+        set_log_level(LOG_DEBUG);
+        argc--;
+        argv++;
+    }
+    if (argc < 2)
     {
-        std::cerr << "Error: Not a valid PNG file." << std::endl;
+        print_usage();
         return EXIT_FAILURE;
     }
-    std::cout << "Parse PNG header successfully!" << std::endl;
 
-    // Read chunks
-    while (true)
+    if (std::strcmp(argv[1], "--batch") == 0)
+        return run_batch(argc, argv);
+    if (std::strcmp(argv[1], "--probe") == 0)
+        return run_probe(argc, argv);
+    if (std::strcmp(argv[1], "--inflate-bench") == 0)
+        return run_inflate_bench();
+
+    png_properties_t img_properties;
+    if (std::strcmp(argv[1], "-") == 0)
     {
-        uint8_t chunk_length_c[4];
-        stream.read(reinterpret_cast<char *>(chunk_length_c), sizeof(4));
-        if (stream.eof())
-            break; // Stop if we can't read 4 bytes (end of file)
-        uint32_t chunk_length = chunk_length_c[0] << 24 | chunk_length_c[1] << 16 | chunk_length_c[2] << 8 | chunk_length_c[3];
+        // Decode png image from memory
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        if (!decode_png_memory(payload, img_properties))
+            return EXIT_FAILURE;
+    }
+    else if (!decode_png_file(argv[1], img_properties)) // Decode png image (the file is memory-mapped)
+        return EXIT_FAILURE;
+    if (verbose)
+        std::cout << "Decode stats:\n" << img_properties.stats;
 
-        char chunk_type[4];
-        stream.read(chunk_type, 4);
-        if (std::strncmp(chunk_type, "IHDR", 4) == 0)
-        {
-            if (parse_ihdr_chunk(stream, chunk_length, properties.ihdr))
-            {
-                std::cout << "Image properties:\n" << properties.ihdr << std::endl;
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "PLTE", 4) == 0)
-        {
-            if (parse_plte_chunk(stream, chunk_length, properties.palette))
-            {
-                // Process palette
-                std::cout << "Palette: " << properties.palette.size() << std::endl;
-                // for (const auto &rgb : palette)
-                //{
-                //    std::cout << "(" << static_cast<int>(rgb.red) << ", " << static_cast<int>(rgb.green) << ", " << static_cast<int>(rgb.blue) << ")\n";
-                //}
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "IDAT", 4) == 0)
-        {
-            if (parse_idat_chunk(stream, chunk_length, properties.compressed_data))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "IEND", 4) == 0)
-        {
-            if (parse_iend_chunk(stream, chunk_length))
-            {
-                // End reading png image
-                // Decompress IDAT data
-                std::vector<uint8_t> decompressed_data = decompress_idat_data(properties.compressed_data);
+    // Save the decoded image to a file, for example
+    std::ofstream output_file("decoded_image.bin", std::ios::binary);
+    output_file.write(reinterpret_cast<const char *>(img_properties.pixels.data()), img_properties.pixels.size());
+    output_file.close();
 
-                // Process decompressed data
-                // Save the decompressed image to a file, for example
-                std::ofstream output_file("decompressed_image.bin", std::ios::binary);
-                output_file.write(reinterpret_cast<const char *>(decompressed_data.data()), decompressed_data.size());
-                output_file.close();
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "bKGD", 4) == 0)
-        {
-            if (parse_bkgd_chunk(stream, chunk_length, properties.bkgd))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "cHRM", 4) == 0)
-        {
-            if (parse_chrm_chunk(stream, chunk_length, properties.chrm))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "cICP", 4) == 0)
-        {
-            if (parse_cicp_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "dSIG", 4) == 0)
-        {
-            if (parse_dsig_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "eXIf", 4) == 0)
-        {
-            if (parse_exif_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "gAMA", 4) == 0)
-        {
-            if (parse_gama_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "hIST", 4) == 0)
-        {
-            if (parse_hist_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "iCCP", 4) == 0)
-        {
-            if (parse_iccp_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "iTXt", 4) == 0)
-        {
-            if (parse_itxt_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "pHYs", 4) == 0)
-        {
-            if (parse_phys_chunk(stream, chunk_length, properties.phys))
-            {
-                std::cout << "Physical properties:\n" << properties.phys << std::endl;
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "sBIT", 4) == 0)
-        {
-            if (parse_sbit_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "sPLT", 4) == 0)
-        {
-            if (parse_splt_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "sRGB", 4) == 0)
-        {
-            if (parse_srgb_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "sTER", 4) == 0)
-        {
-            if (parse_ster_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "tEXt", 4) == 0)
-        {
-            if (parse_text_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "tIME", 4) == 0)
-        {
-            if (parse_time_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "tRNS", 4) == 0)
-        {
-            if (parse_trns_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-        else if (std::strncmp(chunk_type, "zTXt", 4) == 0)
-        {
-            if (parse_ztxt_chunk(stream, chunk_length))
-            {
-            }
-            else
-                return false;
-        }
-    }
-    return true;
+    return EXIT_SUCCESS;
 }
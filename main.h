@@ -1,11 +1,16 @@
 #ifndef __MAIN_H__
 #define __MAIN_H__
 
-#include "parsing_chunks.h"
+#include "batch_decoder.h"
+#include "decode_log.h"
+#include "inflate_backend.h"
+#include "png_decoder.h"
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
-
-bool decode_png_file(std::ifstream &stream, png_properties_t &properties);
+#include <iterator>
+#include <string>
+#include <vector>
 
 #endif // __MAIN_H__